@@ -0,0 +1,92 @@
+#include "atomic_file.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+bool write_file_atomically(std::string const &filename, std::vector< FilePiece > const &pieces) {
+	std::string temporary = filename + ".tmp";
+	HANDLE file = CreateFileA(temporary.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		std::cerr << "Failed to open '" << temporary << "' for writing." << std::endl;
+		return false;
+	}
+	bool ok = true;
+	for (FilePiece const &piece : pieces) {
+		char const *data = reinterpret_cast< char const * >(piece.data);
+		size_t left = piece.size;
+		while (ok && left > 0) {
+			DWORD wrote = 0;
+			DWORD chunk = DWORD(left < (1u << 30) ? left : (1u << 30));
+			ok = WriteFile(file, data, chunk, &wrote, nullptr) && wrote > 0;
+			data += wrote;
+			left -= wrote;
+		}
+	}
+	ok = ok && FlushFileBuffers(file);
+	CloseHandle(file);
+	ok = ok && MoveFileExA(temporary.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+	if (!ok) {
+		std::cerr << "Failed to write '" << filename << "' (via '" << temporary << "')." << std::endl;
+		DeleteFileA(temporary.c_str());
+	}
+	return ok;
+}
+
+#else
+
+bool write_file_atomically(std::string const &filename, std::vector< FilePiece > const &pieces) {
+	std::string temporary = filename + ".tmp";
+	int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		std::cerr << "Failed to open '" << temporary << "' for writing: " << std::strerror(errno) << std::endl;
+		return false;
+	}
+	bool ok = true;
+	for (FilePiece const &piece : pieces) {
+		char const *data = reinterpret_cast< char const * >(piece.data);
+		size_t left = piece.size;
+		while (ok && left > 0) {
+			ssize_t wrote = write(fd, data, left);
+			if (wrote < 0 && errno == EINTR) continue;
+			ok = (wrote > 0);
+			if (ok) {
+				data += wrote;
+				left -= size_t(wrote);
+			}
+		}
+	}
+	ok = ok && fsync(fd) == 0;
+	ok = (close(fd) == 0) && ok;
+	ok = ok && std::rename(temporary.c_str(), filename.c_str()) == 0;
+	if (!ok) {
+		std::cerr << "Failed to write '" << filename << "' (via '" << temporary << "'): " << std::strerror(errno) << std::endl;
+		std::remove(temporary.c_str());
+		return false;
+	}
+
+	//(make the rename itself durable)
+	std::string directory = ".";
+	size_t slash = filename.rfind('/');
+	if (slash != std::string::npos) directory = (slash == 0 ? std::string("/") : filename.substr(0, slash));
+	int dir = open(directory.c_str(), O_RDONLY);
+	if (dir >= 0) {
+		fsync(dir);
+		close(dir);
+	}
+	return true;
+}
+
+#endif
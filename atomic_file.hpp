@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stddef.h>
+
+/*
+ * Replacing a file so that a crash (of the game or the machine) at any
+ * point leaves either the old file or the whole new one, never a mix.
+ *
+ * The new contents go to '<filename>.tmp' and are flushed to the disk
+ * (fsync / FlushFileBuffers) before being renamed over 'filename'; on POSIX
+ * the directory is synced too, so the rename itself survives a power cut.
+ */
+
+//a run of bytes to write:
+struct FilePiece {
+	void const *data;
+	size_t size;
+};
+
+//write 'pieces', in order, as the new contents of 'filename';
+// returns false (with a message on std::cerr, and the old file untouched) on failure:
+bool write_file_atomically(std::string const &filename, std::vector< FilePiece > const &pieces);
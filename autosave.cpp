@@ -0,0 +1,156 @@
+#include "autosave.hpp"
+#include "atomic_file.hpp"
+#include "snapshot.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+Autosaver::Autosaver(std::string const &filename_, uint64_t interval_) : filename(filename_), interval(interval_ ? interval_ : 1) {
+	thread = std::thread(&Autosaver::thread_main, this);
+}
+
+Autosaver::~Autosaver() {
+	{
+		std::lock_guard< std::mutex > guard(lock);
+		quit = true;
+	}
+	wake.notify_one();
+	thread.join(); //(after writing any queued job)
+}
+
+void Autosaver::update(GameState const &state) {
+	if (next_due > state.ticks + interval) next_due = state.ticks + interval; //(the state went back, e.g. a snapshot was loaded)
+	if (state.ticks < next_due) return;
+	{
+		std::lock_guard< std::mutex > guard(lock);
+		if (writing) {
+			if (!late) counts.delayed += 1;
+			late = true;
+			return;
+		}
+	}
+	late = false;
+	next_due = state.ticks + interval;
+	take(state);
+}
+
+void Autosaver::take(GameState const &state) {
+	PROFILE_ZONE("autosave snapshot");
+	auto before = std::chrono::steady_clock::now();
+
+	std::vector< Piece > pieces;
+	pieces.reserve(state.screens.size() + 2);
+
+	std::shared_ptr< std::vector< uint8_t > > head = std::make_shared< std::vector< uint8_t > >();
+	snapshot_head(state, head.get());
+	pieces.emplace_back(std::move(head));
+
+	uint64_t copied = 0, reused = 0;
+	for (Screen const &at : state.screens) {
+		Cached &cached = chunks[at.coord.key()];
+		if (cached.bytes && cached.version == at.version) {
+			reused += 1;
+		} else {
+			//(a fresh buffer; the saving thread may still hold the old one)
+			std::shared_ptr< std::vector< uint8_t > > bytes = std::make_shared< std::vector< uint8_t > >();
+			snapshot_screen(at, bytes.get());
+			cached.version = at.version;
+			cached.bytes = std::move(bytes);
+			copied += 1;
+		}
+		pieces.emplace_back(cached.bytes);
+	}
+	//(forget chunks that have been unloaded)
+	for (auto at = chunks.begin(); at != chunks.end(); ) {
+		if (state.loaded.count(at->first)) ++at;
+		else at = chunks.erase(at);
+	}
+
+	std::shared_ptr< std::vector< uint8_t > > tail = std::make_shared< std::vector< uint8_t > >();
+	snapshot_tail(state, tail.get());
+	pieces.emplace_back(std::move(tail));
+
+	double seconds = std::chrono::duration< double >(std::chrono::steady_clock::now() - before).count();
+	{
+		std::lock_guard< std::mutex > guard(lock);
+		job.seed = state.seed;
+		job.animals = state.animals;
+		job.pieces = std::move(pieces);
+		queued = true;
+		writing = true;
+		counts.copy_seconds += seconds;
+		counts.copy_max_seconds = std::max(counts.copy_max_seconds, seconds);
+		counts.chunks_copied += copied;
+		counts.chunks_reused += reused;
+	}
+	wake.notify_one();
+}
+
+void Autosaver::wait() {
+	std::unique_lock< std::mutex > guard(lock);
+	written.wait(guard, [this](){ return !writing; });
+}
+
+void Autosaver::thread_main() {
+	PROFILE_THREAD_NAME("autosave");
+	while (true) {
+		Job current;
+		{
+			std::unique_lock< std::mutex > guard(lock);
+			wake.wait(guard, [this](){ return quit || queued; });
+			if (!queued) return;
+			current = std::move(job);
+			queued = false;
+		}
+
+		PROFILE_ZONE("autosave write");
+		auto before = std::chrono::steady_clock::now();
+		uint64_t size = 0;
+		for (Piece const &piece : current.pieces) {
+			size += piece->size();
+		}
+		SnapshotHash hash(size);
+		for (Piece const &piece : current.pieces) {
+			hash.add(piece->data(), piece->size());
+		}
+		uint8_t header[SnapshotHeaderSize];
+		snapshot_header(current.seed, current.animals, size, hash.value, header);
+
+		std::vector< FilePiece > file;
+		file.reserve(current.pieces.size() + 1);
+		file.emplace_back(FilePiece{header, SnapshotHeaderSize});
+		for (Piece const &piece : current.pieces) {
+			file.emplace_back(FilePiece{piece->data(), piece->size()});
+		}
+		bool ok = write_file_atomically(filename, file);
+		double seconds = std::chrono::duration< double >(std::chrono::steady_clock::now() - before).count();
+
+		current.pieces.clear(); //(drop our references before the next snapshot reuses anything)
+		{
+			std::lock_guard< std::mutex > guard(lock);
+			if (ok) {
+				counts.saves += 1;
+				counts.bytes = SnapshotHeaderSize + size;
+			} else {
+				counts.failures += 1;
+			}
+			counts.write_seconds += seconds;
+			writing = false;
+		}
+		written.notify_all();
+	}
+}
+
+void Autosaver::report(std::ostream &out) const {
+	uint64_t taken = counts.saves + counts.failures;
+	out << "Autosave: " << counts.saves << " saves to '" << filename << "' (" << counts.failures << " failed, "
+	    << counts.delayed << " delayed while the previous one was still being written)";
+	if (taken) {
+		out << "; game thread " << counts.copy_seconds * 1000.0 / double(taken) << " ms per save (max " << counts.copy_max_seconds * 1000.0 << " ms), copying "
+		    << counts.chunks_copied << " chunks and reusing " << counts.chunks_reused << " unchanged; saving thread "
+		    << counts.write_seconds * 1000.0 / double(taken) << " ms per save (hash, write, fsync, rename), " << counts.bytes << " bytes";
+	}
+	out << "." << std::endl;
+}
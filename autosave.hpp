@@ -0,0 +1,95 @@
+#pragma once
+
+#include "game.hpp"
+
+#include <condition_variable>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+
+/*
+ * Saving snapshots (see snapshot.hpp) every so often without stalling the
+ * game.
+ *
+ * At a tick boundary, update() takes a copy of the state. The small parts
+ * (the player, deltas, respawns and timers) are serialized outright. Each
+ * loaded chunk's bytes are shared with the previous autosave unless the
+ * chunk has changed since then (Screen::version). So usually only the
+ * player's chunk is copied. Shared bytes are reference-counted and never
+ * modified; a chunk that changes gets new bytes, while the saving thread
+ * may still be writing the old ones. That makes it copy-on-write, a chunk
+ * at a time.
+ *
+ * The saving thread then hashes the pieces and writes them out atomically
+ * (fsync, then rename over the previous save; see atomic_file.hpp), so a
+ * crash never leaves a half-written save behind.
+ *
+ * The time update() spends on the game thread is measured and reported.
+ */
+
+struct Autosaver {
+	//save to 'filename' every 'interval' ticks:
+	Autosaver(std::string const &filename, uint64_t interval);
+	~Autosaver(); //waits for the save in progress
+	Autosaver(Autosaver const &) = delete;
+	Autosaver &operator=(Autosaver const &) = delete;
+
+	//(game thread, between ticks) take a snapshot if one is due; if the previous one is still being written,
+	// try again next tick:
+	void update(GameState const &state);
+	//(game thread) wait until the save in progress (if any) is on disk:
+	void wait();
+
+	struct Stats {
+		uint64_t saves = 0; //written
+		uint64_t failures = 0;
+		uint64_t delayed = 0; //due while the previous save was still being written
+		double copy_seconds = 0.0; //game thread time in update(), when it took a snapshot
+		double copy_max_seconds = 0.0;
+		uint64_t chunks_copied = 0;
+		uint64_t chunks_reused = 0; //unchanged since the previous snapshot, so shared with it
+		double write_seconds = 0.0; //saving thread time (hash, write, fsync, rename)
+		uint64_t bytes = 0; //size of the latest save
+	};
+	//(call wait() first, for the saving thread's counts to be current)
+	Stats const &stats() const { return counts; }
+	void report(std::ostream &out) const;
+
+	//------------ internals ------------
+	std::string filename;
+	uint64_t interval;
+	uint64_t next_due = 0; //tick
+	bool late = false; //(counted in 'delayed' already)
+
+	typedef std::shared_ptr< std::vector< uint8_t > const > Piece;
+	//each loaded chunk's bytes as of the latest snapshot, by ChunkCoord::key():
+	struct Cached {
+		uint64_t version;
+		Piece bytes;
+	};
+	std::unordered_map< uint64_t, Cached > chunks;
+
+	//a snapshot handed to the saving thread:
+	struct Job {
+		uint32_t seed = 0;
+		uint32_t animals = 0;
+		std::vector< Piece > pieces; //the payload, in order
+	};
+	Job job;
+	bool queued = false; //'job' is waiting to be picked up
+	bool writing = false; //a snapshot has been taken and isn't on disk yet
+	bool quit = false;
+	std::mutex lock; //guards the above, and the saving thread's stats
+	std::condition_variable wake; //saving thread waits for a job
+	std::condition_variable written; //game thread waits for the save to finish
+	Stats counts;
+	std::thread thread;
+
+	void take(GameState const &state);
+	void thread_main();
+};
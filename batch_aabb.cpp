@@ -0,0 +1,252 @@
+#include "batch_aabb.hpp"
+
+#include <algorithm>
+
+//(SSE2 is part of the x86-64 baseline, so only 64-bit x86 builds get the SIMD paths)
+#if defined(__x86_64__) || defined(_M_X64)
+#define BATCH_AABB_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+//------------ scalar ------------
+//(the SIMD versions use these for the elements past the last full vector)
+
+static void points_in_box_scalar_from(uint32_t begin, float const *x, float const *y, uint32_t count, glm::vec2 min, glm::vec2 max, uint8_t *masks) {
+	for (uint32_t i = begin; i < count; ++i) {
+		if ((i & 7) == 0) masks[i >> 3] = 0;
+		bool hit = (x[i] >= min.x) && (x[i] <= max.x) && (y[i] >= min.y) && (y[i] <= max.y);
+		masks[i >> 3] |= uint8_t(hit) << (i & 7);
+	}
+}
+
+static void boxes_contain_point_scalar_from(uint32_t begin, float const *x, float const *y, float const *half, uint32_t count, glm::vec2 point, uint8_t *masks) {
+	for (uint32_t i = begin; i < count; ++i) {
+		if ((i & 7) == 0) masks[i >> 3] = 0;
+		float r = half[i];
+		bool hit = (point.x > (x[i] - r)) && (point.x < (x[i] + r))
+		        && (point.y > (y[i] - r)) && (point.y < (y[i] + r));
+		masks[i >> 3] |= uint8_t(hit) << (i & 7);
+	}
+}
+
+static void chase_step_scalar_from(uint32_t begin, float *x, float *y, float const *speed, float rate, uint8_t const *masks, uint32_t count, glm::vec2 point) {
+	for (uint32_t i = begin; i < count; ++i) {
+		if (!((masks[i >> 3] >> (i & 7)) & 1)) continue;
+		float step = speed[i] * rate;
+		if ((point.x - x[i]) < 0) x[i] -= step;
+		else if ((point.x - x[i]) > 0) x[i] += step;
+		if ((point.y - y[i]) < 0) y[i] -= step;
+		else if ((point.y - y[i]) > 0) y[i] += step;
+	}
+}
+
+static void points_in_box_scalar(float const *x, float const *y, uint32_t count, glm::vec2 min, glm::vec2 max, uint8_t *masks) {
+	points_in_box_scalar_from(0, x, y, count, min, max, masks);
+}
+static void boxes_contain_point_scalar(float const *x, float const *y, float const *half, uint32_t count, glm::vec2 point, uint8_t *masks) {
+	boxes_contain_point_scalar_from(0, x, y, half, count, point, masks);
+}
+static void chase_step_scalar(float *x, float *y, float const *speed, float rate, uint8_t const *masks, uint32_t count, glm::vec2 point) {
+	chase_step_scalar_from(0, x, y, speed, rate, masks, count, point);
+}
+
+#ifdef BATCH_AABB_X86
+
+//------------ SSE2 ------------
+//four elements per step; two steps make one mask byte.
+
+static void points_in_box_sse2(float const *x, float const *y, uint32_t count, glm::vec2 min, glm::vec2 max, uint8_t *masks) {
+	__m128 min_x = _mm_set1_ps(min.x), max_x = _mm_set1_ps(max.x);
+	__m128 min_y = _mm_set1_ps(min.y), max_y = _mm_set1_ps(max.y);
+	uint32_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		int bits[2];
+		for (uint32_t h = 0; h < 2; ++h) {
+			__m128 px = _mm_loadu_ps(x + i + 4*h);
+			__m128 py = _mm_loadu_ps(y + i + 4*h);
+			__m128 in = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(px, min_x), _mm_cmple_ps(px, max_x)),
+			                       _mm_and_ps(_mm_cmpge_ps(py, min_y), _mm_cmple_ps(py, max_y)));
+			bits[h] = _mm_movemask_ps(in);
+		}
+		masks[i >> 3] = uint8_t(bits[0] | (bits[1] << 4));
+	}
+	points_in_box_scalar_from(i, x, y, count, min, max, masks);
+}
+
+static void boxes_contain_point_sse2(float const *x, float const *y, float const *half, uint32_t count, glm::vec2 point, uint8_t *masks) {
+	__m128 px = _mm_set1_ps(point.x), py = _mm_set1_ps(point.y);
+	uint32_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		int bits[2];
+		for (uint32_t h = 0; h < 2; ++h) {
+			__m128 bx = _mm_loadu_ps(x + i + 4*h);
+			__m128 by = _mm_loadu_ps(y + i + 4*h);
+			__m128 r = _mm_loadu_ps(half + i + 4*h);
+			__m128 in = _mm_and_ps(
+				_mm_and_ps(_mm_cmpgt_ps(px, _mm_sub_ps(bx, r)), _mm_cmplt_ps(px, _mm_add_ps(bx, r))),
+				_mm_and_ps(_mm_cmpgt_ps(py, _mm_sub_ps(by, r)), _mm_cmplt_ps(py, _mm_add_ps(by, r))));
+			bits[h] = _mm_movemask_ps(in);
+		}
+		masks[i >> 3] = uint8_t(bits[0] | (bits[1] << 4));
+	}
+	boxes_contain_point_scalar_from(i, x, y, half, count, point, masks);
+}
+
+//'value' moved by 'step' towards 'target' where 'active' (SSE2 has no blendv, so select with and/andnot):
+static inline __m128 step_towards_sse2(__m128 value, __m128 target, __m128 step, __m128 active) {
+	__m128 zero = _mm_setzero_ps();
+	__m128 d = _mm_sub_ps(target, value);
+	__m128 down = _mm_and_ps(active, _mm_cmplt_ps(d, zero));
+	__m128 up = _mm_and_ps(active, _mm_cmpgt_ps(d, zero));
+	__m128 keep = _mm_andnot_ps(_mm_or_ps(down, up), value);
+	return _mm_or_ps(keep, _mm_or_ps(_mm_and_ps(down, _mm_sub_ps(value, step)), _mm_and_ps(up, _mm_add_ps(value, step))));
+}
+
+static void chase_step_sse2(float *x, float *y, float const *speed, float rate, uint8_t const *masks, uint32_t count, glm::vec2 point) {
+	__m128 px = _mm_set1_ps(point.x), py = _mm_set1_ps(point.y);
+	__m128 vrate = _mm_set1_ps(rate);
+	__m128i lane_bits = _mm_setr_epi32(1, 2, 4, 8);
+	uint32_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		if (masks[i >> 3] == 0) continue;
+		for (uint32_t h = 0; h < 2; ++h) {
+			__m128i bits = _mm_set1_epi32((masks[i >> 3] >> (4*h)) & 0xf);
+			__m128 active = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(bits, lane_bits), lane_bits));
+			__m128 step = _mm_mul_ps(_mm_loadu_ps(speed + i + 4*h), vrate);
+			_mm_storeu_ps(x + i + 4*h, step_towards_sse2(_mm_loadu_ps(x + i + 4*h), px, step, active));
+			_mm_storeu_ps(y + i + 4*h, step_towards_sse2(_mm_loadu_ps(y + i + 4*h), py, step, active));
+		}
+	}
+	chase_step_scalar_from(i, x, y, speed, rate, masks, count, point);
+}
+
+//------------ AVX2 ------------
+//eight elements (one mask byte) per step.
+
+TARGET_AVX2
+static void points_in_box_avx2(float const *x, float const *y, uint32_t count, glm::vec2 min, glm::vec2 max, uint8_t *masks) {
+	__m256 min_x = _mm256_set1_ps(min.x), max_x = _mm256_set1_ps(max.x);
+	__m256 min_y = _mm256_set1_ps(min.y), max_y = _mm256_set1_ps(max.y);
+	uint32_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256 px = _mm256_loadu_ps(x + i);
+		__m256 py = _mm256_loadu_ps(y + i);
+		__m256 in = _mm256_and_ps(
+			_mm256_and_ps(_mm256_cmp_ps(px, min_x, _CMP_GE_OQ), _mm256_cmp_ps(px, max_x, _CMP_LE_OQ)),
+			_mm256_and_ps(_mm256_cmp_ps(py, min_y, _CMP_GE_OQ), _mm256_cmp_ps(py, max_y, _CMP_LE_OQ)));
+		masks[i >> 3] = uint8_t(_mm256_movemask_ps(in));
+	}
+	_mm256_zeroupper(); //(the scalar tail is non-VEX code)
+	points_in_box_scalar_from(i, x, y, count, min, max, masks);
+}
+
+TARGET_AVX2
+static void boxes_contain_point_avx2(float const *x, float const *y, float const *half, uint32_t count, glm::vec2 point, uint8_t *masks) {
+	__m256 px = _mm256_set1_ps(point.x), py = _mm256_set1_ps(point.y);
+	uint32_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256 bx = _mm256_loadu_ps(x + i);
+		__m256 by = _mm256_loadu_ps(y + i);
+		__m256 r = _mm256_loadu_ps(half + i);
+		__m256 in = _mm256_and_ps(
+			_mm256_and_ps(_mm256_cmp_ps(px, _mm256_sub_ps(bx, r), _CMP_GT_OQ), _mm256_cmp_ps(px, _mm256_add_ps(bx, r), _CMP_LT_OQ)),
+			_mm256_and_ps(_mm256_cmp_ps(py, _mm256_sub_ps(by, r), _CMP_GT_OQ), _mm256_cmp_ps(py, _mm256_add_ps(by, r), _CMP_LT_OQ)));
+		masks[i >> 3] = uint8_t(_mm256_movemask_ps(in));
+	}
+	_mm256_zeroupper(); //(the scalar tail is non-VEX code)
+	boxes_contain_point_scalar_from(i, x, y, half, count, point, masks);
+}
+
+TARGET_AVX2
+static inline __m256 step_towards_avx2(__m256 value, __m256 target, __m256 step, __m256 active) {
+	__m256 zero = _mm256_setzero_ps();
+	__m256 d = _mm256_sub_ps(target, value);
+	__m256 down = _mm256_and_ps(active, _mm256_cmp_ps(d, zero, _CMP_LT_OQ));
+	__m256 up = _mm256_and_ps(active, _mm256_cmp_ps(d, zero, _CMP_GT_OQ));
+	value = _mm256_blendv_ps(value, _mm256_sub_ps(value, step), down);
+	//('up' lanes weren't touched by the line above, so 'value' there is still the original)
+	return _mm256_blendv_ps(value, _mm256_add_ps(value, step), up);
+}
+
+TARGET_AVX2
+static void chase_step_avx2(float *x, float *y, float const *speed, float rate, uint8_t const *masks, uint32_t count, glm::vec2 point) {
+	__m256 px = _mm256_set1_ps(point.x), py = _mm256_set1_ps(point.y);
+	__m256 vrate = _mm256_set1_ps(rate);
+	__m256i lane_bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+	uint32_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		if (masks[i >> 3] == 0) continue;
+		__m256i bits = _mm256_set1_epi32(masks[i >> 3]);
+		__m256 active = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(bits, lane_bits), lane_bits));
+		__m256 step = _mm256_mul_ps(_mm256_loadu_ps(speed + i), vrate);
+		_mm256_storeu_ps(x + i, step_towards_avx2(_mm256_loadu_ps(x + i), px, step, active));
+		_mm256_storeu_ps(y + i, step_towards_avx2(_mm256_loadu_ps(y + i), py, step, active));
+	}
+	_mm256_zeroupper(); //(the scalar tail is non-VEX code)
+	chase_step_scalar_from(i, x, y, speed, rate, masks, count, point);
+}
+
+static bool cpu_has_avx2() {
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return false;
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	if (!osxsave || !avx) return false;
+	if ((_xgetbv(0) & 0x6) != 0x6) return false; //OS saves ymm state
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif //BATCH_AABB_X86
+
+static SimdLevel simd_cap = SimdLevel::AVX2;
+
+void simd_limit(SimdLevel level) {
+	simd_cap = level;
+}
+
+SimdLevel simd_best() {
+#ifdef BATCH_AABB_X86
+	static SimdLevel const detected = cpu_has_avx2() ? SimdLevel::AVX2 : SimdLevel::SSE2;
+	return std::min(detected, simd_cap);
+#else
+	return SimdLevel::Scalar;
+#endif
+}
+
+char const *simd_name(SimdLevel level) {
+	if (level == SimdLevel::AVX2) return "AVX2";
+	else if (level == SimdLevel::SSE2) return "SSE2";
+	else return "scalar";
+}
+
+AabbKernels const &aabb_kernels(SimdLevel level) {
+	static AabbKernels const scalar{points_in_box_scalar, boxes_contain_point_scalar, chase_step_scalar};
+#ifdef BATCH_AABB_X86
+	static AabbKernels const sse2{points_in_box_sse2, boxes_contain_point_sse2, chase_step_sse2};
+	static AabbKernels const avx2{points_in_box_avx2, boxes_contain_point_avx2, chase_step_avx2};
+	if (level > simd_best()) level = simd_best();
+	if (level == SimdLevel::AVX2) return avx2;
+	if (level == SimdLevel::SSE2) return sse2;
+#else
+	(void)level;
+#endif
+	return scalar;
+}
+
+AabbKernels const &aabb_kernels() {
+	return aabb_kernels(simd_best());
+}
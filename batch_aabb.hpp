@@ -0,0 +1,42 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <stdint.h>
+
+/*
+ * Batched axis-aligned box tests over structure-of-arrays columns.
+ *
+ * Each kernel writes (or reads) a hit bitmask with one byte per eight
+ * elements: bit j of masks[k] is element 8*k + j. The SSE2 and AVX2 versions
+ * test four or eight elements per instruction and give bit-for-bit the same
+ * results as the scalar versions (same comparisons, same single-rounding
+ * arithmetic), so which one runs never changes the simulation.
+ *
+ * 'masks' must have room for (count + 7) / 8 bytes.
+ */
+
+enum class SimdLevel : uint8_t {
+	Scalar,
+	SSE2,
+	AVX2,
+};
+
+//best level this CPU (and build) supports, up to the simd_limit():
+SimdLevel simd_best();
+//don't use anything above 'level' (for comparing levels; affects kernels fetched afterwards):
+void simd_limit(SimdLevel level);
+char const *simd_name(SimdLevel level);
+
+struct AabbKernels {
+	//points (x[i], y[i]) inside the closed box [min, max]:
+	void (*points_in_box)(float const *x, float const *y, uint32_t count, glm::vec2 min, glm::vec2 max, uint8_t *masks);
+	//boxes x[i] +/- half[i], y[i] +/- half[i] that strictly contain 'point':
+	void (*boxes_contain_point)(float const *x, float const *y, float const *half, uint32_t count, glm::vec2 point, uint8_t *masks);
+	//for elements with their mask bit set, step each axis of (x[i], y[i]) by speed[i] * rate towards 'point':
+	void (*chase_step)(float *x, float *y, float const *speed, float rate, uint8_t const *masks, uint32_t count, glm::vec2 point);
+};
+
+//kernels for 'level' (falls back to the best supported level if 'level' isn't):
+AabbKernels const &aabb_kernels(SimdLevel level);
+AabbKernels const &aabb_kernels();
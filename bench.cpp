@@ -0,0 +1,519 @@
+#include "batch_aabb.hpp"
+#include "entities.hpp"
+#include "frame_arena.hpp"
+#include "memory_stats.hpp"
+#include "spatial.hpp"
+#include "rng.hpp"
+#include "timer_wheel.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <queue>
+#include <sstream>
+#include <vector>
+
+/*
+ * Micro-benchmarks for the simulation's data structures.
+ *
+ * Usage: bench [name ...]   (runs everything if no names are given)
+ */
+
+//seconds taken by f():
+template< typename F >
+static double time_it(F const &f) {
+	auto before = std::chrono::steady_clock::now();
+	f();
+	auto after = std::chrono::steady_clock::now();
+	return std::chrono::duration< double >(after - before).count();
+}
+
+//------------ spatial ------------
+//SpatialHash against a linear scan, for points spread over the [-1,1]x[-1,1] game screen.
+
+static void bench_spatial() {
+	std::cout << "spatial: " << "1000 box queries at contact (0.05) and aggro (0.5) half-sizes; times in ms\n";
+	std::cout << std::setw(9) << "points"
+	          << std::setw(10) << "insert"
+	          << std::setw(10) << "move all"
+	          << std::setw(12) << "0.05 grid" << std::setw(12) << "0.05 scan"
+	          << std::setw(12) << "0.5 grid" << std::setw(12) << "0.5 scan"
+	          << '\n';
+
+	for (uint32_t count : {10000u, 100000u, 1000000u}) {
+		std::vector< float > xs(count), ys(count);
+		RngBatch(1, 1).uniform(xs.data(), count, -1.0f, 1.0f);
+		RngBatch(1, 2).uniform(ys.data(), count, -1.0f, 1.0f);
+
+		SpatialHash grid(0.125f);
+		double insert = time_it([&](){
+			for (uint32_t i = 0; i < count; ++i) {
+				grid.insert(i, glm::vec2(xs[i], ys[i]));
+			}
+		});
+
+		//everything takes a small step, as chasing animals do each tick:
+		double move = time_it([&](){
+			for (uint32_t i = 0; i < count; ++i) {
+				xs[i] += 0.0005f;
+				ys[i] -= 0.0005f;
+				grid.move(i, glm::vec2(xs[i], ys[i]));
+			}
+		});
+
+		std::vector< float > centers(2000);
+		RngBatch(1, 3).uniform(centers.data(), centers.size(), -1.0f, 1.0f);
+
+		std::cout << std::setw(9) << count
+		          << std::setw(10) << std::fixed << std::setprecision(2) << insert * 1e3
+		          << std::setw(10) << move * 1e3;
+
+		for (float radius : {0.05f, 0.5f}) {
+			uint64_t grid_hits = 0, scan_hits = 0;
+			std::vector< uint32_t > found;
+			double grid_time = time_it([&](){
+				for (uint32_t q = 0; q < 1000; ++q) {
+					glm::vec2 c(centers[2*q], centers[2*q+1]);
+					found.clear();
+					grid.in_box(c - glm::vec2(radius), c + glm::vec2(radius), &found);
+					grid_hits += found.size();
+				}
+			});
+			double scan_time = time_it([&](){
+				for (uint32_t q = 0; q < 1000; ++q) {
+					glm::vec2 c(centers[2*q], centers[2*q+1]);
+					found.clear();
+					for (uint32_t i = 0; i < count; ++i) {
+						if (xs[i] >= c.x - radius && xs[i] <= c.x + radius
+						 && ys[i] >= c.y - radius && ys[i] <= c.y + radius) found.emplace_back(i);
+					}
+					scan_hits += found.size();
+				}
+			});
+			if (grid_hits != scan_hits) {
+				std::cerr << "spatial: grid found " << grid_hits << " points but scan found " << scan_hits << "." << std::endl;
+			}
+			std::cout << std::setw(12) << grid_time * 1e3 << std::setw(12) << scan_time * 1e3;
+		}
+		std::cout << std::endl;
+	}
+}
+
+//------------ aabb ------------
+//Batched box kernels at each SIMD level, checked against the scalar results.
+
+static void bench_aabb() {
+	std::cout << "aabb: best level here is " << simd_name(simd_best()) << "; ns per element, speedup over scalar in ()\n";
+	std::cout << std::setw(9) << "elements" << std::setw(8) << "level"
+	          << std::setw(18) << "points_in_box"
+	          << std::setw(22) << "boxes_contain_point"
+	          << std::setw(18) << "chase_step"
+	          << '\n';
+
+	for (uint32_t count : {10000u, 100000u, 1000000u}) {
+		std::vector< float > xs(count), ys(count), half(count), speed(count);
+		RngBatch(2, 1).uniform(xs.data(), count, -1.0f, 1.0f);
+		RngBatch(2, 2).uniform(ys.data(), count, -1.0f, 1.0f);
+		RngBatch(2, 3).uniform(half.data(), count, 0.1f, 0.5f);
+		RngBatch(2, 4).uniform(speed.data(), count, 0.0002f, 0.0005f);
+		glm::vec2 player(0.1f, -0.2f);
+		uint32_t const repeats = std::max(1u, 20000000u / count);
+
+		struct Result {
+			std::vector< uint8_t > box_masks, point_masks;
+			std::vector< float > xs, ys;
+			double seconds[3];
+		};
+		Result results[3];
+
+		for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2}) {
+			if (level > simd_best()) continue;
+			AabbKernels const &k = aabb_kernels(level);
+			Result &r = results[uint32_t(level)];
+			r.box_masks.resize((count + 7) / 8);
+			r.point_masks.resize((count + 7) / 8);
+			r.xs = xs;
+			r.ys = ys;
+			r.seconds[0] = time_it([&](){
+				for (uint32_t rep = 0; rep < repeats; ++rep) {
+					k.points_in_box(xs.data(), ys.data(), count, glm::vec2(-0.5f), glm::vec2(0.5f), r.box_masks.data());
+				}
+			});
+			r.seconds[1] = time_it([&](){
+				for (uint32_t rep = 0; rep < repeats; ++rep) {
+					k.boxes_contain_point(xs.data(), ys.data(), half.data(), count, player, r.point_masks.data());
+				}
+			});
+			r.seconds[2] = time_it([&](){
+				for (uint32_t rep = 0; rep < repeats; ++rep) {
+					k.chase_step(r.xs.data(), r.ys.data(), speed.data(), 1.0f, r.point_masks.data(), count, player);
+				}
+			});
+
+			Result const &ref = results[0];
+			if (level != SimdLevel::Scalar && (r.box_masks != ref.box_masks || r.point_masks != ref.point_masks || r.xs != ref.xs || r.ys != ref.ys)) {
+				std::cerr << "aabb: " << simd_name(level) << " results differ from scalar at " << count << " elements!" << std::endl;
+			}
+
+			std::cout << std::setw(9) << count << std::setw(8) << simd_name(level);
+			int widths[3] = {18, 22, 18};
+			for (uint32_t t = 0; t < 3; ++t) {
+				double ns = r.seconds[t] / double(repeats) / double(count) * 1e9;
+				std::ostringstream cell;
+				cell << std::fixed << std::setprecision(3) << ns << " (" << std::setprecision(1) << ref.seconds[t] / r.seconds[t] << "x)";
+				std::cout << std::setw(widths[t]) << cell.str();
+			}
+			std::cout << std::endl;
+		}
+	}
+}
+
+//------------ trees ------------
+//Lazy (closed-form) tree regrowth against growing every stump each tick, with a few percent of trees cut.
+
+static void bench_trees() {
+	uint32_t const count = 1000000;
+	float const per_tick = 0.0002f; //(GameState::treeGrowRate)
+	float const tick_rate = 60.0f;
+	float const per_second = per_tick * tick_rate;
+	uint32_t const ticks = 600;
+	std::cout << "trees: " << count << " trees; eager regrowth per tick (lazy ticks do no tree work at all),\n"
+	          << "  then every height worked out lazily after " << ticks << " ticks, and point queries; times in ms\n";
+	std::cout << std::setw(8) << "cut"
+	          << std::setw(14) << "eager/tick"
+	          << std::setw(14) << "lazy heights"
+	          << std::setw(16) << "1000 tree_at"
+	          << '\n';
+
+	std::vector< float > xs(count), ys(count);
+	RngBatch(3, 1).uniform(xs.data(), count, -1.0f, 1.0f);
+	RngBatch(3, 2).uniform(ys.data(), count, -1.0f, 1.0f);
+	Trees trees;
+	for (uint32_t i = 0; i < count; ++i) {
+		trees.add(glm::vec2(xs[i], ys[i]));
+	}
+	std::vector< float > centers(2000);
+	RngBatch(3, 3).uniform(centers.data(), centers.size(), -1.0f, 1.0f);
+
+	for (float fraction : {0.01f, 0.03f, 0.1f}) {
+		//cut a random 'fraction' of the trees at random times over the last minute:
+		std::vector< float > height(count, 1.0f);
+		std::vector< float > picks(2 * uint32_t(count * fraction));
+		RngBatch(3, 4).uniform(picks.data(), picks.size(), 0.0f, 1.0f);
+		std::fill(trees.grown_at.begin(), trees.grown_at.end(), 0.0f);
+		float now = 60.0f;
+		for (uint32_t p = 0; p + 1 < picks.size(); p += 2) {
+			uint32_t i = std::min(count - 1, uint32_t(picks[p] * count));
+			float when = now - 60.0f * picks[p + 1];
+			cut_tree(trees, i, when, per_second);
+			height[i] = tree_height(trees, i, now, per_second);
+		}
+
+		//the old way: every stump grows a little each tick
+		double eager = time_it([&](){
+			for (uint32_t t = 0; t < ticks; ++t) {
+				for (uint32_t i = 0; i < count; ++i) {
+					if (height[i] < 1.0f) {
+						height[i] = (height[i] + per_tick > 1.0f ? 1.0f : height[i] + per_tick);
+					}
+				}
+			}
+		});
+		now += float(ticks) / tick_rate;
+
+		//lazy: ticks don't touch trees at all; heights cost something only when asked for
+		float worst = 0.0f;
+		double lazy_heights = time_it([&](){
+			for (uint32_t i = 0; i < count; ++i) {
+				float h = tree_height(trees, i, now, per_second);
+				worst = std::max(worst, std::abs(h - height[i]));
+			}
+		});
+		if (worst > 1e-3f) {
+			std::cerr << "trees: lazy heights differ from eager regrowth by up to " << worst << "." << std::endl;
+		}
+
+		uint32_t found = 0;
+		double queries = time_it([&](){
+			for (uint32_t q = 0; q < 1000; ++q) {
+				if (tree_at(trees, glm::vec2(centers[2*q], centers[2*q+1]), 0.05f, now) >= 0) ++found;
+			}
+		});
+
+		std::cout << std::setw(7) << std::fixed << std::setprecision(0) << fraction * 100.0f << '%'
+		          << std::setw(14) << std::setprecision(3) << eager / ticks * 1e3
+		          << std::setw(14) << lazy_heights * 1e3
+		          << std::setw(16) << queries * 1e3
+		          << std::endl;
+	}
+}
+
+//------------ timers ------------
+//TimerWheel against a binary heap and against polling every timer each tick, with 1M timers pending.
+
+static void bench_timers() {
+	uint32_t const count = 1000000;
+	std::cout << "timers: " << count << " timers due at random ticks in [1, span); ms for all, and ns per tick or per timer\n";
+	std::cout << std::setw(10) << "span"
+	          << std::setw(12) << "schedule"
+	          << std::setw(12) << "fire all"
+	          << std::setw(12) << "ns/tick"
+	          << std::setw(12) << "ns/timer"
+	          << std::setw(12) << "heap"
+	          << std::setw(14) << "poll ns/tick"
+	          << '\n';
+
+	for (uint32_t span_bits : {16u, 20u, 24u}) {
+		uint64_t span = uint64_t(1) << span_bits;
+		std::vector< float > picks(count);
+		RngBatch(4, span_bits).uniform(picks.data(), count, 0.0f, 1.0f);
+		std::vector< uint64_t > dues(count);
+		for (uint32_t i = 0; i < count; ++i) {
+			dues[i] = 1 + std::min(span - 2, uint64_t(picks[i] * float(span - 1)));
+		}
+
+		TimerWheel wheel;
+		double schedule = time_it([&](){
+			for (uint32_t i = 0; i < count; ++i) {
+				wheel.schedule(dues[i], dues[i]);
+			}
+		});
+		//(payloads are the due ticks, so firing can be checked against the clock)
+		uint64_t fired = 0, late = 0;
+		double fire = time_it([&](){
+			wheel.advance(span, [&](uint64_t due) {
+				++fired;
+				if (due != wheel.now()) ++late;
+			});
+		});
+		if (fired != count || late != 0 || wheel.size() != 0) {
+			std::cerr << "timers: fired " << fired << " of " << count << ", " << late << " on the wrong tick." << std::endl;
+		}
+
+		std::priority_queue< uint64_t, std::vector< uint64_t >, std::greater< uint64_t > > heap;
+		double heap_time = time_it([&](){
+			for (uint32_t i = 0; i < count; ++i) {
+				heap.push(dues[i]);
+			}
+			while (!heap.empty()) heap.pop();
+		});
+
+		//polling, as respawns used to work: check every timer on every tick (just a few ticks' worth)
+		uint32_t const poll_ticks = 20;
+		uint64_t polled = 0;
+		double poll = time_it([&](){
+			for (uint64_t t = 1; t <= poll_ticks; ++t) {
+				for (uint32_t i = 0; i < count; ++i) {
+					if (dues[i] == t) ++polled;
+				}
+			}
+		});
+		if (polled != uint64_t(std::count_if(dues.begin(), dues.end(), [](uint64_t due) { return due <= poll_ticks; }))) {
+			std::cerr << "timers: polling found the wrong number of due timers." << std::endl;
+		}
+
+		std::cout << std::setw(8) << "2^" << std::setw(2) << std::left << span_bits << std::right
+		          << std::setw(12) << std::fixed << std::setprecision(2) << schedule * 1e3
+		          << std::setw(12) << fire * 1e3
+		          << std::setw(12) << std::setprecision(1) << fire / double(span) * 1e9
+		          << std::setw(12) << fire / double(count) * 1e9
+		          << std::setw(12) << std::setprecision(2) << heap_time * 1e3
+		          << std::setw(14) << std::setprecision(0) << poll / poll_ticks * 1e9
+		          << std::endl;
+	}
+}
+
+//------------ pool ------------
+//Spawning and killing entities through Entities' slot map, at a steady population.
+
+static void bench_pool() {
+	std::cout << "pool: kill a random live entity and spawn a new one, 1M times; ns per kill+spawn\n";
+	std::cout << std::setw(10) << "capacity"
+	          << std::setw(10) << "alive"
+	          << std::setw(12) << "ns/churn"
+	          << std::setw(16) << "reallocations"
+	          << std::setw(14) << "stale caught"
+	          << std::setw(16) << "sweep live us"
+	          << std::setw(16) << "sweep all us"
+	          << '\n';
+
+	for (uint32_t capacity : {10000u, 100000u, 1000000u}) {
+		//half the pool alive; the rest is what parking dead entities used to leave in every loop:
+		uint32_t const alive = capacity / 2;
+		uint32_t const churns = 1000000;
+		Entities e;
+		e.reserve(capacity);
+		std::vector< Handle > live;
+		live.reserve(alive);
+		Rng rng(5, 1);
+		for (uint32_t i = 0; i < alive; ++i) {
+			live.emplace_back(e.add(EntityKind::Wolf, glm::vec2(rng.uniform(-1.0f, 1.0f), rng.uniform(-1.0f, 1.0f)), rng));
+		}
+		float const *before = e.x.data();
+		uint32_t reallocations = 0;
+
+		std::vector< Handle > killed;
+		killed.reserve(churns);
+		double churn = time_it([&](){
+			for (uint32_t c = 0; c < churns; ++c) {
+				uint32_t pick = rng.next() % alive;
+				e.remove(live[pick]);
+				killed.emplace_back(live[pick]);
+				live[pick] = e.add(EntityKind::Wolf, glm::vec2(rng.uniform(-1.0f, 1.0f), rng.uniform(-1.0f, 1.0f)), rng);
+				if (e.x.data() != before) {
+					before = e.x.data();
+					++reallocations;
+				}
+			}
+		});
+
+		//every killed handle must now be stale, even though its slot has been reused:
+		uint32_t stale = 0;
+		for (Handle handle : killed) {
+			if (e.find(handle) == SlotMap::Invalid) ++stale;
+		}
+		if (stale != killed.size() || e.size() != alive) {
+			std::cerr << "pool: only " << stale << " of " << killed.size() << " killed handles were stale." << std::endl;
+		}
+
+		//what a per-tick sweep costs over just the live entities, versus the whole (parked) capacity:
+		std::vector< float > xs(capacity, 10.0f), ys(capacity, 10.0f), half(capacity, 0.5f);
+		std::vector< uint8_t > masks((capacity + 7) / 8);
+		AabbKernels const &k = aabb_kernels();
+		double live_sweep = time_it([&](){
+			for (uint32_t rep = 0; rep < 100; ++rep) {
+				k.boxes_contain_point(e.x.data(), e.y.data(), e.aggro.data(), e.size(), glm::vec2(0.0f), masks.data());
+			}
+		});
+		double all_sweep = time_it([&](){
+			for (uint32_t rep = 0; rep < 100; ++rep) {
+				k.boxes_contain_point(xs.data(), ys.data(), half.data(), capacity, glm::vec2(0.0f), masks.data());
+			}
+		});
+
+		std::cout << std::setw(10) << capacity
+		          << std::setw(10) << alive
+		          << std::setw(12) << std::fixed << std::setprecision(1) << churn / churns * 1e9
+		          << std::setw(16) << reallocations
+		          << std::setw(14) << stale
+		          << std::setw(16) << live_sweep / 100.0 * 1e6
+		          << std::setw(16) << all_sweep / 100.0 * 1e6
+		          << std::endl;
+	}
+}
+
+//------------ arena ------------
+//Building a frame's vertex list in a std::vector (as the draw code used to) against a FrameVector.
+
+static void bench_arena() {
+	//(same layout as main.cpp's Vertex)
+	struct Vertex {
+		Vertex(glm::vec2 const &Position_, glm::vec2 const &TexCoord_, glm::u8vec4 const &Color_) :
+			Position(Position_), TexCoord(TexCoord_), Color(Color_) { }
+		glm::vec2 Position;
+		glm::vec2 TexCoord;
+		glm::u8vec4 Color;
+	};
+	uint32_t const frames = 1000;
+	std::cout << "arena: vertex lists for " << frames << " frames; us per frame, heap allocations per frame\n";
+	std::cout << std::setw(9) << "sprites"
+	          << std::setw(14) << "std::vector"
+	          << std::setw(10) << "allocs"
+	          << std::setw(14) << "FrameVector"
+	          << std::setw(10) << "allocs"
+	          << std::setw(14) << "peak bytes"
+	          << '\n';
+
+	for (uint32_t sprites : {100u, 10000u, 100000u}) {
+		uint64_t checksum[2] = {0, 0};
+		auto fill = [&](uint32_t frame, std::vector< Vertex > *plain, FrameVector< Vertex > *framed) {
+			glm::u8vec4 tint(0xff);
+			for (uint32_t i = 0; i < sprites; ++i) {
+				glm::vec2 at(float(i % 100), float(frame));
+				for (uint32_t v = 0; v < 6; ++v) {
+					if (plain) plain->emplace_back(at, glm::vec2(float(v)), tint);
+					else framed->emplace_back(at, glm::vec2(float(v)), tint);
+				}
+			}
+		};
+
+		uint64_t heap_before = heap_allocations();
+		double plain_time = time_it([&](){
+			for (uint32_t frame = 0; frame < frames; ++frame) {
+				std::vector< Vertex > verts;
+				fill(frame, &verts, nullptr);
+				checksum[0] += verts.size();
+			}
+		});
+		uint64_t plain_allocs = heap_allocations() - heap_before;
+
+		FrameArena arena;
+		//(one warm-up frame, so the arena has grown to fit)
+		uint64_t framed_allocs = 0;
+		double framed_time = 0.0;
+		for (uint32_t frame = 0; frame <= frames; ++frame) {
+			heap_before = heap_allocations();
+			double t = time_it([&](){
+				arena.reset();
+				FrameVector< Vertex > verts{FrameAllocator< Vertex >(arena)};
+				verts.reserve(6 * sprites);
+				fill(frame, nullptr, &verts);
+				checksum[1] += (frame ? verts.size() : 0);
+			});
+			if (frame == 0) continue;
+			framed_time += t;
+			framed_allocs += heap_allocations() - heap_before;
+		}
+		if (checksum[0] != checksum[1]) {
+			std::cerr << "arena: built " << checksum[1] << " vertices, expected " << checksum[0] << "." << std::endl;
+		}
+
+		std::cout << std::setw(9) << sprites
+		          << std::setw(14) << std::fixed << std::setprecision(1) << plain_time / frames * 1e6
+		          << std::setw(10) << std::setprecision(1) << double(plain_allocs) / frames
+		          << std::setw(14) << framed_time / frames * 1e6
+		          << std::setw(10) << double(framed_allocs) / frames
+		          << std::setw(14) << arena.peak()
+		          << std::endl;
+	}
+}
+
+//------------ main ------------
+
+int main(int argc, char **argv) {
+	struct Bench {
+		char const *name;
+		void (*run)();
+	};
+	Bench const benches[] = {
+		{"spatial", bench_spatial},
+		{"aabb", bench_aabb},
+		{"trees", bench_trees},
+		{"timers", bench_timers},
+		{"pool", bench_pool},
+		{"arena", bench_arena},
+	};
+
+	bool ran = false;
+	for (Bench const &bench : benches) {
+		bool wanted = (argc == 1);
+		for (int argi = 1; argi < argc; ++argi) {
+			if (std::strcmp(argv[argi], bench.name) == 0) wanted = true;
+		}
+		if (!wanted) continue;
+		bench.run();
+		ran = true;
+	}
+	if (!ran) {
+		std::cerr << "Usage:\n\t" << argv[0] << " [name ...]\nBenchmarks:";
+		for (Bench const &bench : benches) {
+			std::cerr << ' ' << bench.name;
+		}
+		std::cerr << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,172 @@
+#include "entities.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+
+//per-kind starting values:
+struct KindInfo {
+	float speed; //initial chase speed
+	float base_speed; //respawn speed factor
+	float damage;
+	int32_t meat;
+	float respawn_time;
+	float aggro;
+};
+
+//aggravated animal radius boxes start at speed * 1000:
+static KindInfo const kind_info[] = {
+	//speed    base_speed damage    meat respawn  aggro
+	{ 0.0002f, 0.0002f,   0.0002f,  1,   30.0f,   0.0002f * 1000.0f }, //Wolf: spawns every 30 seconds
+	{ 0.0005f, 0.0003f,   0.0003f,  2,   60.0f,   0.0005f * 1000.0f }, //Leopard: spawns every minute
+	{ 0.0003f, 0.0005f,   0.0005f,  3,   120.0f,  0.0003f * 1000.0f }, //Lion: spawns every other minute
+	{ 0.0f,    0.0f,      0.0f,     0,   0.0f,    0.1f },              //Wizard: never moves or dies
+};
+
+void Entities::reserve(uint32_t count) {
+	kind.reserve(count);
+	x.reserve(count);
+	y.reserve(count);
+	prev_x.reserve(count);
+	prev_y.reserve(count);
+	speed.reserve(count);
+	base_speed.reserve(count);
+	aggro.reserve(count);
+	damage.reserve(count);
+	meat.reserve(count);
+	respawn_time.reserve(count);
+	collide.reserve(count);
+	rng.reserve(count);
+	handles.reserve(count);
+	collided.reserve(count);
+	aggro_masks.reserve((count + 7) / 8);
+}
+
+Handle Entities::add(EntityKind kind_, glm::vec2 const &position, Rng const &rng_) {
+	KindInfo const &info = kind_info[uint32_t(kind_)];
+	kind.emplace_back(kind_);
+	x.emplace_back(position.x);
+	y.emplace_back(position.y);
+	prev_x.emplace_back(position.x);
+	prev_y.emplace_back(position.y);
+	speed.emplace_back(info.speed);
+	base_speed.emplace_back(info.base_speed);
+	aggro.emplace_back(info.aggro);
+	damage.emplace_back(info.damage);
+	meat.emplace_back(info.meat);
+	respawn_time.emplace_back(info.respawn_time);
+	collide.emplace_back(0);
+	rng.emplace_back(rng_);
+	return handles.insert();
+}
+
+//move a column's last element into 'hole':
+template< typename T >
+static void fill(std::vector< T > &column, uint32_t hole) {
+	column[hole] = column.back();
+	column.pop_back();
+}
+
+void Entities::remove(Handle handle) {
+	uint32_t hole = handles.erase(handle);
+	fill(kind, hole);
+	fill(x, hole);
+	fill(y, hole);
+	fill(prev_x, hole);
+	fill(prev_y, hole);
+	fill(speed, hole);
+	fill(base_speed, hole);
+	fill(aggro, hole);
+	fill(damage, hole);
+	fill(meat, hole);
+	fill(respawn_time, hole);
+	fill(collide, hole);
+	fill(rng, hole);
+}
+
+void Trees::add(glm::vec2 const &position) {
+	x.emplace_back(position.x);
+	y.emplace_back(position.y);
+	grown_at.emplace_back(0.0f);
+	grid.insert(size() - 1, position);
+}
+
+void aggro_system(Entities &e, uint32_t begin, uint32_t end, glm::vec2 const &player, float rate, PartitionDelta *delta) {
+	//aggro boxes are big (up to a quarter of the screen), so sweep the columns eight at a time:
+	AabbKernels const &kernels = *e.kernels;
+	uint8_t *masks = e.aggro_masks.data() + begin / 8;
+	uint32_t count = end - begin;
+	kernels.boxes_contain_point(e.x.data() + begin, e.y.data() + begin, e.aggro.data() + begin, count, player, masks);
+	//find vector to player pos, update position
+	kernels.chase_step(e.x.data() + begin, e.y.data() + begin, e.speed.data() + begin, rate, masks, count, player);
+
+	//every aggro box contains the contact box, so only this tick's hits can be touching the player:
+	for (uint32_t m = 0; m < (count + 7) / 8; ++m) {
+		for (uint32_t bits = masks[m]; bits; bits &= bits - 1) {
+			uint32_t i = begin + 8 * m + SpatialHash::ctz8(bits);
+			e.collide[i] = 1;
+			delta->collided.emplace_back(i);
+			if ((player.x > (e.x[i] - ContactRadius)) && (player.x < (e.x[i] + ContactRadius))
+			 && (player.y > (e.y[i] - ContactRadius)) && (player.y < (e.y[i] + ContactRadius))) {
+				delta->damage += e.damage[i] * rate;
+			}
+		}
+	}
+}
+
+EntityTotals update_entities(Entities &e, glm::vec2 const &player, float rate, JobSystem *jobs) {
+	PROFILE_ZONE("entities");
+	for (Handle handle : e.collided) {
+		uint32_t i = e.find(handle);
+		if (i != SlotMap::Invalid) e.collide[i] = 0;
+	}
+	e.collided.clear();
+
+	uint32_t count = e.size();
+	e.aggro_masks.resize((count + 7) / 8);
+	e.deltas.resize((count + PartitionSize - 1) / PartitionSize);
+
+	//parallel phase: partitions only write their own entities and their own delta
+	auto partition = [&](uint32_t begin, uint32_t end) {
+		PartitionDelta &delta = e.deltas[begin / PartitionSize];
+		delta.damage = 0.0f;
+		delta.collided.clear();
+		aggro_system(e, begin, end, player, rate, &delta);
+	};
+	if (jobs) jobs->parallel_for(0, count, PartitionSize, partition);
+	else for (uint32_t begin = 0; begin < count; begin += PartitionSize) {
+		partition(begin, std::min(count, begin + PartitionSize));
+	}
+
+	//reduction phase: combine deltas in partition order, so the totals don't depend on which thread ran what
+	EntityTotals totals{0.0f};
+	for (PartitionDelta const &delta : e.deltas) {
+		totals.damage += delta.damage;
+		for (uint32_t i : delta.collided) {
+			e.collided.emplace_back(e.handles.handle_at(i));
+		}
+	}
+	return totals;
+}
+
+void cut_tree(Trees &trees, uint32_t i, float now, float per_second) {
+	trees.grown_at[i] = now + 1.0f / per_second;
+}
+
+float tree_height(Trees const &trees, uint32_t i, float now, float per_second) {
+	float left = trees.grown_at[i] - now;
+	if (left <= 0.0f) return 1.0f;
+	return std::max(0.0f, 1.0f - left * per_second);
+}
+
+int32_t tree_at(Trees const &trees, glm::vec2 const &player, float radius, float now) {
+	int32_t found = -1;
+	glm::vec2 reach = glm::vec2(radius);
+	trees.grid.for_each_in_box(player - reach, player + reach, [&](uint32_t i, glm::vec2 const &) {
+		if (trees.grown_at[i] <= now
+			&& (player.x > (trees.x[i] - radius)) && (player.x < (trees.x[i] + radius))
+			&& (player.y > (trees.y[i] - radius)) && (player.y < (trees.y[i] + radius))) {
+			found = std::max(found, int32_t(i)); //(the last matching tree, as before)
+		}
+	});
+	return found;
+}
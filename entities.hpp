@@ -0,0 +1,112 @@
+#pragma once
+
+#include "rng.hpp"
+#include "spatial.hpp"
+#include "batch_aabb.hpp"
+#include "jobs.hpp"
+#include "pool.hpp"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <stdint.h>
+
+/*
+ * Structure-of-arrays storage for the things that live in the world.
+ *
+ * Index i in every column of Entities is the same entity. Entities are
+ * kept packed (removing one moves the last into its place), so loops only
+ * ever see live entities; anything that holds on to an entity across
+ * removals keeps a Handle instead of an index (see pool.hpp).
+ *
+ * Per-tick entity updates work on fixed partitions of PartitionSize
+ * entities. Each partition only writes its own entities plus its own
+ * PartitionDelta, and the deltas are then combined in partition order, so
+ * the result is bit-identical however many threads ran the partitions.
+ */
+
+enum class EntityKind : uint8_t {
+	Wolf,
+	Leopard,
+	Lion,
+	Wizard,
+};
+
+//entities per partition (a multiple of eight, so partitions own whole mask bytes):
+constexpr uint32_t PartitionSize = 4096;
+
+//what updating one partition did to state outside it:
+struct PartitionDelta {
+	float damage = 0.0f; //contact damage to the player, summed in index order
+	std::vector< uint32_t > collided; //entities that now have 'collide' set, in index order
+};
+
+//animals and the wizard:
+struct Entities {
+	//make room for 'count' entities, so adding up to that many never allocates:
+	void reserve(uint32_t count);
+	//new entity at index size() - 1:
+	Handle add(EntityKind kind, glm::vec2 const &position, Rng const &rng);
+	//O(1); the last entity moves into the removed one's index:
+	void remove(Handle handle);
+	//index of the entity 'handle' names, or SlotMap::Invalid if it has been removed:
+	uint32_t find(Handle handle) const { return handles.find(handle); }
+	uint32_t size() const { return uint32_t(kind.size()); }
+
+	std::vector< EntityKind > kind;
+	std::vector< float > x, y; //position in [-1,1]x[-1,1] screen coordinates
+	std::vector< float > prev_x, prev_y; //position at the start of the latest tick (for drawing)
+	std::vector< float > speed; //distance moved per tick when chasing the player
+	std::vector< float > base_speed; //respawned animals get base_speed * (totalTime / 100)
+	std::vector< float > aggro; //half-size of the box in which the entity notices the player
+	std::vector< float > damage; //health taken from the player per tick on contact
+	std::vector< int32_t > meat; //meat harvested from the entity
+	std::vector< float > respawn_time; //seconds between death and respawn
+	std::vector< uint8_t > collide; //player was inside the aggro box at the latest tick
+	std::vector< Rng > rng; //per-entity random stream for (re)spawn positions
+	SlotMap handles; //handle <-> index
+
+	std::vector< Handle > collided; //entities with 'collide' set, in index order (as of the latest update)
+	std::vector< uint8_t > aggro_masks; //aggro_system's hit bits (see batch_aabb.hpp)
+	std::vector< PartitionDelta > deltas; //one per partition, reused each tick
+	AabbKernels const *kernels = &aabb_kernels();
+};
+
+//trees on one screen; cut trees regrow at a constant rate, so each only stores when it will be full-grown again
+// (heights are worked out when drawn or queried, and nothing needs updating per tick):
+struct Trees {
+	void add(glm::vec2 const &position);
+	uint32_t size() const { return uint32_t(grown_at.size()); }
+
+	std::vector< float > x, y;
+	std::vector< float > grown_at; //totalTime from which the tree is full-grown; a stump before that
+
+	SpatialHash grid = SpatialHash(0.125f); //positions by tree index
+};
+
+//distance from the player within which an entity does contact damage:
+constexpr float ContactRadius = 0.05f;
+
+//------------ systems ------------
+//(each works on the partition [begin, end) and records outside effects in 'delta')
+
+//entities that see the player step 'rate' times their speed towards them and set 'collide';
+// those that end up touching the player add their damage (scaled by 'rate'):
+void aggro_system(Entities &entities, uint32_t begin, uint32_t end, glm::vec2 const &player, float rate, PartitionDelta *delta);
+
+//combined effect of one tick of entity updates:
+struct EntityTotals {
+	float damage; //(already summed in partition order)
+};
+
+//run the systems above over every partition (spread over 'jobs' if given), then combine the deltas:
+EntityTotals update_entities(Entities &entities, glm::vec2 const &player, float rate, JobSystem *jobs = nullptr);
+
+//cut tree 'i' down to a stump at 'now'; it grows back 'per_second' of its full height each second:
+void cut_tree(Trees &trees, uint32_t i, float now, float per_second);
+
+//height of tree 'i' at 'now' (1.0 is full-grown; less is a stump):
+float tree_height(Trees const &trees, uint32_t i, float now, float per_second);
+
+//index of a full-grown (at 'now') tree within 'radius' of the player, or -1:
+int32_t tree_at(Trees const &trees, glm::vec2 const &player, float radius, float now);
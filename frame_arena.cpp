@@ -0,0 +1,58 @@
+#include "frame_arena.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <new>
+
+static FrameArena::Block new_block(size_t size, MemTag tag) {
+	MemTagScope scope(tag);
+	FrameArena::Block block;
+	block.data = static_cast< uint8_t * >(::operator new(size));
+	block.size = size;
+	block.top = 0;
+	return block;
+}
+
+FrameArena::FrameArena(size_t capacity, MemTag tag_) : block_size(capacity), tag(tag_) {
+	MemTagScope scope(tag);
+	blocks.reserve(8);
+	blocks.emplace_back(new_block(block_size, tag));
+}
+
+FrameArena::~FrameArena() {
+	for (Block &block : blocks) {
+		::operator delete(block.data);
+	}
+}
+
+void *FrameArena::allocate(size_t bytes, size_t align) {
+	assert((align & (align - 1)) == 0 && align <= alignof(std::max_align_t) && "alignment must be a power of two, no stricter than malloc's");
+	Block *block = &blocks.back();
+	size_t start = (block->top + align - 1) & ~(align - 1);
+	if (start + bytes > block->size) {
+		//overflow: a heap block for the rest of this frame (reset() folds it into the arena):
+		blocks.emplace_back(new_block(std::max(bytes, block_size), tag));
+		block = &blocks.back();
+		start = 0;
+	}
+	block->top = start + bytes;
+	used_bytes += bytes;
+	return block->data + start;
+}
+
+void FrameArena::reset() {
+	peak_bytes = std::max(peak_bytes, used_bytes);
+	if (blocks.size() > 1) {
+		//this frame didn't fit; make one block that would have held all of it:
+		size_t total = 0;
+		for (Block &block : blocks) {
+			total += block.size;
+			::operator delete(block.data);
+		}
+		blocks.clear();
+		block_size = total;
+		blocks.emplace_back(new_block(block_size, tag));
+	}
+	blocks[0].top = 0;
+	used_bytes = 0;
+}
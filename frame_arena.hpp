@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <stdint.h>
+
+#include "memory_stats.hpp"
+
+/*
+ * Per-frame linear ("bump") allocator for data that only lives until the
+ * end of the frame (vertex lists and other temporaries).
+ *
+ * allocate() just advances a pointer; nothing is freed individually, and
+ * reset() at the top of each frame makes the whole arena available again.
+ * If a frame needs more than the arena holds, extra blocks come from the
+ * heap for that frame, and the next reset() replaces everything with one
+ * block big enough for it. So once the frame size has settled, frames do
+ * no heap allocation at all.
+ *
+ * FrameAllocator< T > adapts an arena for standard containers (see
+ * FrameVector); deallocation is a no-op, so reserve() up front instead of
+ * letting a vector grow through several sizes.
+ *
+ * Blocks come from operator new, charged to the arena's MemTag, so the
+ * arena shows up in the memory stats by size, not by what is in it.
+ */
+
+struct FrameArena {
+	explicit FrameArena(size_t capacity = 64 * 1024, MemTag tag = MemTag::Other);
+	~FrameArena();
+	FrameArena(FrameArena const &) = delete;
+	FrameArena &operator=(FrameArena const &) = delete;
+
+	//'bytes' of storage aligned to 'align' (a power of two), valid until the next reset():
+	void *allocate(size_t bytes, size_t align = alignof(std::max_align_t));
+
+	//start a new frame (everything allocated so far is released):
+	void reset();
+
+	//bytes allocated so far this frame:
+	size_t used() const { return used_bytes; }
+	//most bytes any one frame has used:
+	size_t peak() const { return peak_bytes; }
+	//bytes the arena holds without going to the heap:
+	size_t capacity() const { return block_size; }
+
+	//------------ internals ------------
+	struct Block {
+		uint8_t *data;
+		size_t size;
+		size_t top;
+	};
+	std::vector< Block > blocks; //blocks[0] is the arena proper; any others are this frame's overflow
+	size_t block_size;
+	MemTag tag;
+	size_t used_bytes = 0;
+	size_t peak_bytes = 0;
+};
+
+template< typename T >
+struct FrameAllocator {
+	typedef T value_type;
+
+	explicit FrameAllocator(FrameArena &arena_) : arena(&arena_) { }
+	template< typename U >
+	FrameAllocator(FrameAllocator< U > const &other) : arena(other.arena) { }
+
+	T *allocate(size_t count) {
+		return static_cast< T * >(arena->allocate(count * sizeof(T), alignof(T)));
+	}
+	void deallocate(T *, size_t) {
+		//(freed all at once by FrameArena::reset)
+	}
+
+	FrameArena *arena;
+};
+
+template< typename T, typename U >
+bool operator==(FrameAllocator< T > const &a, FrameAllocator< U > const &b) { return a.arena == b.arena; }
+template< typename T, typename U >
+bool operator!=(FrameAllocator< T > const &a, FrameAllocator< U > const &b) { return a.arena != b.arena; }
+
+//vector in frame memory; must not outlive the frame it was made in:
+template< typename T >
+using FrameVector = std::vector< T, FrameAllocator< T > >;
@@ -0,0 +1,412 @@
+#include "game.hpp"
+#include "profiler.hpp"
+#include "memory_stats.hpp"
+#include "streaming.hpp"
+#include "world_save.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+//stream ids for a chunk's generators (the i'th entity created uses EntityStream + i):
+enum : uint64_t {
+	TreeStream = 1,
+	EntityStream = 16,
+};
+
+static void enter_chunk(GameState &s, ChunkCoord const &chunk);
+
+GameState::GameState(uint32_t seed_, uint32_t animals_, ChunkDeltas deltas_) : seed(seed_), animals(animals_), deltas(std::move(deltas_)) {
+	//wizard lives just right of the starting screen (off screen, but exists initially):
+	wizard_chunk.x = 1;
+
+	MemTagScope tag(MemTag::Entities);
+	screens.reserve(2 * KeepRecent);
+	loaded.reserve(2 * KeepRecent);
+	left.reserve(2 * KeepRecent);
+	//(animals only leave a chunk when they die, so this holds every respawn unless the player kills
+	// their way through more than a few chunks' worth before any come back)
+	respawns.reserve(3 * animals * KeepRecent);
+	timers.reserve(3 * animals * KeepRecent);
+
+	enter_chunk(*this, ChunkCoord());
+}
+
+Screen *GameState::find(ChunkCoord const &chunk) {
+	auto found = loaded.find(chunk.key());
+	return (found == loaded.end() ? nullptr : &screens[found->second]);
+}
+
+//seed for a chunk's generators: a hash (splitmix64's mixer) of the world seed and the chunk's coordinates:
+static uint64_t chunk_seed(uint32_t seed, ChunkCoord const &chunk) {
+	uint64_t h = chunk.key() ^ (uint64_t(seed) * 0x9e3779b97f4a7c15ULL);
+	h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+	return h ^ (h >> 31);
+}
+
+void generate_screen(uint32_t seed, ChunkCoord const &chunk, uint32_t animals, bool wizard, Screen *screen) {
+	//(everything comes from the chunk's own generators, so it comes out the same whenever, and on whichever thread, it is made)
+	uint64_t const hash = chunk_seed(seed, chunk);
+	screen->coord = chunk;
+	screen->respawning = 0;
+	uint64_t stream = EntityStream;
+	{
+		MemTagScope tag(MemTag::Entities);
+		Entities &entities = screen->entities;
+		entities.reserve(3 * animals + (wizard ? 1 : 0));
+		//animals in wolf, leopard, lion order (attacks and harvesting pick the first one in reach):
+		for (EntityKind kind : {EntityKind::Wolf, EntityKind::Leopard, EntityKind::Lion}) {
+			for (uint32_t i = 0; i < animals; ++i) {
+				Rng rng(hash, stream++);
+				glm::vec2 pos;
+				pos.x = rng.uniform(-1.0f, 1.0f);
+				pos.y = rng.uniform(-1.0f, 1.0f);
+				entities.add(kind, pos, rng);
+			}
+		}
+		if (wizard) {
+			entities.add(EntityKind::Wizard, glm::vec2(-0.4f, 0.2f), Rng(hash, stream++));
+		}
+	}
+
+	//place trees randomly on the screen (x,y pairs):
+	MemTagScope tag(MemTag::World);
+	float coords[2 * TreesPerScreen];
+	RngBatch(hash, TreeStream).uniform(coords, 2 * TreesPerScreen, -1.0f, 1.0f);
+	for (int i = 0; i < TreesPerScreen; i++) {
+		screen->trees.add(glm::vec2(coords[2 * i], coords[2 * i + 1]));
+	}
+}
+
+void GameState::snap_previous() {
+	previous_playerpos = playerpos;
+	//(the player's screen changes every tick; this is the first thing each tick does to it)
+	screens[screen].version = ++versions;
+	Entities &here = screens[screen].entities;
+	here.prev_x = here.x;
+	here.prev_y = here.y;
+}
+
+uint64_t GameState::checksum() const {
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	auto mix = [&hash](void const *data, size_t size) {
+		uint8_t const *bytes = reinterpret_cast< uint8_t const * >(data);
+		for (size_t i = 0; i < size; ++i) {
+			hash ^= bytes[i];
+			hash *= 0x100000001b3ULL;
+		}
+	};
+	auto mix_floats = [&mix](std::vector< float > const &values) {
+		mix(values.data(), values.size() * sizeof(float));
+	};
+
+	mix(&playerpos, sizeof(playerpos));
+	for (Screen const &at : screens) {
+		mix(&at.coord, sizeof(at.coord));
+		mix(&at.respawning, sizeof(at.respawning));
+		mix_floats(at.entities.x);
+		mix_floats(at.entities.y);
+		mix_floats(at.entities.speed);
+		mix_floats(at.trees.x);
+		mix_floats(at.trees.y);
+		mix_floats(at.trees.grown_at);
+	}
+	mix(&playerHealth, sizeof(playerHealth));
+	mix(&playerTemp, sizeof(playerTemp));
+	mix(&lumber, sizeof(lumber));
+	mix(&meat, sizeof(meat));
+	mix(&playerSpeed, sizeof(playerSpeed));
+	mix(&boxSizeMultiplier, sizeof(boxSizeMultiplier));
+	mix(&totalTime, sizeof(totalTime));
+	mix(&ticks, sizeof(ticks));
+	mix(&screens[screen].coord, sizeof(ChunkCoord));
+	uint64_t pending = respawns.size();
+	mix(&pending, sizeof(pending));
+	return hash;
+}
+
+//a dead animal's timer is up; bring it back at a random spot on its screen:
+static void respawn(GameState &s, Handle pending) {
+	Respawn *dead = s.respawns.get(pending);
+	assert(dead && "respawn timer for an animal that isn't dead");
+	Rng rng = dead->rng;
+	glm::vec2 pos;
+	pos.x = rng.uniform(-1.0f, 1.0f);
+	pos.y = rng.uniform(-1.0f, 1.0f);
+	Screen *home = s.find(dead->chunk);
+	assert(home && "chunks with pending respawns stay loaded");
+	home->respawning -= 1;
+	home->version = ++s.versions;
+	Entities &e = home->entities;
+	e.add(dead->kind, pos, rng);
+	uint32_t i = e.size() - 1;
+	e.speed[i] = e.base_speed[i] * (s.totalTime / 100.0f);
+	s.respawns.erase(pending);
+
+	//each time an animal respawns, collision detection boxes on all animals will increase
+	s.boxSizeMultiplier *= 1.5f;
+}
+
+//put back what the player changed in 'at' (forgetting trees that have grown back since):
+static void apply_delta(GameState &s, Screen &at) {
+	auto found = s.deltas.find(at.coord.key());
+	if (found == s.deltas.end()) return;
+	ChunkDelta &delta = found->second;
+	for (uint32_t i = 0; i < uint32_t(TreesPerScreen); ++i) {
+		if (!(delta.cut & (1u << i))) continue;
+		if (delta.grown_at[i] <= s.totalTime) delta.cut &= ~(1u << i);
+		else at.trees.grown_at[i] = delta.grown_at[i];
+	}
+	//(nothing left to remember; the saved copy is skipped the same way when it's loaded)
+	if (!delta.cut) s.deltas.erase(found);
+}
+
+//note that tree 'i' on the player's screen was just cut, so it stays cut when the chunk is generated again (and gets saved):
+static void record_cut(GameState &s, uint32_t i) {
+	MemTagScope tag(MemTag::World);
+	Screen &here = s.screens[s.screen];
+	ChunkDelta &delta = s.deltas[here.coord.key()];
+	delta.coord = here.coord;
+	delta.cut |= 1u << i;
+	delta.grown_at[i] = here.trees.grown_at[i];
+	if (s.saver) s.saver->changed(delta, s.totalTime);
+}
+
+//load 'chunk' (taking it from the streamer if it was prepared ahead, otherwise generating it here) if it isn't loaded,
+// and make it the player's:
+static void enter_chunk(GameState &s, ChunkCoord const &chunk) {
+	auto found = s.loaded.find(chunk.key());
+	if (found != s.loaded.end()) {
+		s.screen = found->second;
+		s.left.erase(std::remove(s.left.begin(), s.left.end(), chunk), s.left.end());
+		return;
+	}
+	s.screen = uint32_t(s.screens.size());
+	s.screens.emplace_back();
+	Screen &at = s.screens.back();
+	bool wizard = (chunk == s.wizard_chunk);
+	if (!s.streamer || !s.streamer->take(chunk, &at)) {
+		generate_screen(s.seed, chunk, s.animals, wizard, &at);
+	}
+	apply_delta(s, at);
+	s.loaded.emplace(chunk.key(), s.screen);
+	at.version = ++s.versions;
+	if (wizard) s.wizard = at.entities.handles.handle_at(at.entities.size() - 1);
+}
+
+//forget a loaded chunk (it will be generated again if the player comes back):
+static void unload_chunk(GameState &s, ChunkCoord const &chunk) {
+	auto found = s.loaded.find(chunk.key());
+	assert(found != s.loaded.end() && found->second != s.screen && "unloading a chunk that isn't loaded, or the player's");
+	uint32_t index = found->second;
+	s.loaded.erase(found);
+	//(fill the hole with the last screen)
+	uint32_t last = uint32_t(s.screens.size() - 1);
+	if (index != last) {
+		std::swap(s.screens[index], s.screens[last]);
+		s.loaded[s.screens[index].coord.key()] = index;
+		if (s.screen == last) s.screen = index;
+	}
+	s.screens.pop_back();
+}
+
+ChunkCoord predicted_chunk(GameState const &s) {
+	ChunkCoord next = s.screens[s.screen].coord;
+	//distance to the edge the player is heading for along each axis (2, more than any, if not heading for one):
+	float to_x = (s.heading.x != 0 && s.playerpos.x * float(s.heading.x) > 0.0f ? 1.0f - std::abs(s.playerpos.x) : 2.0f);
+	float to_y = (s.heading.y != 0 && s.playerpos.y * float(s.heading.y) > 0.0f ? 1.0f - std::abs(s.playerpos.y) : 2.0f);
+	if (to_x >= 2.0f && to_y >= 2.0f) return next;
+	if (to_x <= to_y) next.x += s.heading.x;
+	else next.y += s.heading.y;
+	return next;
+}
+
+//animals stay on their own chunks (and off-screen ones only change through timers), so switching is cheap:
+static void change_chunk(GameState &s, int32_t dx, int32_t dy) {
+	//(nothing on the old screen is in reach any more)
+	Screen &old = s.screens[s.screen];
+	old.version = ++s.versions;
+	Entities &e = old.entities;
+	for (Handle handle : e.collided) {
+		uint32_t i = e.find(handle);
+		if (i != SlotMap::Invalid) e.collide[i] = 0;
+	}
+	e.collided.clear();
+	s.treeCollideInstance = -1;
+
+	ChunkCoord from = old.coord;
+	ChunkCoord chunk = from;
+	chunk.x += dx;
+	chunk.y += dy;
+	enter_chunk(s, chunk);
+
+	//keep the chunk just left for a while, in case the player comes straight back; past the last few,
+	// unload the longest-left ones (except where animals are still due to respawn), since their deltas
+	// are all that regenerating them wouldn't give back:
+	s.left.push_back(from);
+	uint32_t excess = (s.left.size() > GameState::KeepRecent ? uint32_t(s.left.size()) - GameState::KeepRecent : 0);
+	for (auto at = s.left.begin(); excess > 0 && at != s.left.end(); ) {
+		if (s.find(*at)->respawning) {
+			++at;
+			continue;
+		}
+		unload_chunk(s, *at);
+		at = s.left.erase(at);
+		excess -= 1;
+	}
+	s.snap_previous();
+}
+
+//first animal (not the wizard) the player is in reach of, or -1:
+static int32_t animal_in_reach(Entities const &e) {
+	for (Handle handle : e.collided) {
+		uint32_t i = e.find(handle); //(killed this tick, if stale)
+		if (i != SlotMap::Invalid && e.collide[i] && e.kind[i] != EntityKind::Wizard) return int32_t(i);
+	}
+	return -1;
+}
+
+static void apply_action(GameState &s, Action action, float dt) {
+	//for walking (the world has no edges; stepping off the screen moves to the next chunk)
+	if (action == Action::Up) {
+		s.heading.y = 1;
+		if (s.playerpos.y >= 1.0f) {
+			//place player into next screen
+			s.playerpos.y = -std::abs(s.playerpos.y);
+			change_chunk(s, 0, 1);
+		}
+		else
+			s.playerpos.y += s.playerSpeed;
+	}
+	else if (action == Action::Down) {
+		s.heading.y = -1;
+		if (s.playerpos.y <= -1.0f) {
+			s.playerpos.y = std::abs(s.playerpos.y);
+			change_chunk(s, 0, -1);
+		}
+		else
+			s.playerpos.y -= s.playerSpeed;
+	}
+	else if (action == Action::Right) {
+		s.heading.x = 1;
+		if (s.playerpos.x >= 1.0f) {
+			s.playerpos.x = -std::abs(s.playerpos.x);
+			change_chunk(s, 1, 0);
+		}
+		else
+			s.playerpos.x += s.playerSpeed;
+	}
+	else if (action == Action::Left) {
+		s.heading.x = -1;
+		if (s.playerpos.x <= -1.0f) {
+			s.playerpos.x = std::abs(s.playerpos.x);
+			change_chunk(s, -1, 0);
+		}
+		else
+			s.playerpos.x -= s.playerSpeed;
+	}
+
+	//for interaction
+	else if (action == Action::Attack) {
+		//chop down tree or attack
+		//animals
+		Entities &e = s.screens[s.screen].entities;
+		int32_t animal = animal_in_reach(e);
+		if (animal >= 0) {
+			//out of the world until its timer is up (back on the first tick more than respawn_time after this one):
+			Respawn dead;
+			dead.kind = e.kind[animal];
+			dead.chunk = s.screens[s.screen].coord;
+			dead.rng = e.rng[animal];
+			uint64_t wait = (dt > 0.0f ? uint64_t(e.respawn_time[animal] / dt) : 0) + 1;
+			e.remove(e.handles.handle_at(uint32_t(animal)));
+			s.timers.schedule(s.ticks + wait, s.respawns.insert(dead).pack());
+			s.screens[s.screen].respawning += 1;
+		}
+		//tree
+		if (s.treeCollideInstance >= 0) {
+			cut_tree(s.screens[s.screen].trees, s.treeCollideInstance, s.totalTime, s.treeGrowRate * ReferenceTickRate);
+			record_cut(s, uint32_t(s.treeCollideInstance));
+		}
+	}
+	else if (action == Action::DropLumber) {
+		if (s.lumber > 0)
+			s.lumber --;
+	}
+	else if (action == Action::EatMeat) {
+		if (s.meat > 0) {
+			s.meat --;
+			if ((s.playerHealth + s.meatRegen) > 1.0f)
+				s.playerHealth = 1.0f;
+			else
+				s.playerHealth += s.meatRegen;
+		}
+	}
+	else if (action == Action::Interact) {
+		Entities const &e = s.screens[s.screen].entities;
+		int32_t animal = animal_in_reach(e);
+		if (animal >= 0)
+			s.meat += e.meat[animal];
+		//Player interacting with wizard
+		else if (s.screens[s.screen].coord == s.wizard_chunk && e.collide[e.find(s.wizard)]) {
+			if (s.meat > 0) {
+				s.meat --;
+				if ((s.playerHealth + s.wizardRegen) > 1.0f)
+					s.playerHealth = 1.0f;
+				else
+					s.playerHealth += s.wizardRegen;
+			}
+			if (s.lumber > 0) {
+				s.lumber --;
+				if ((s.playerHealth + s.wizardRegen) > 1.0f)
+					s.playerHealth = 1.0f;
+				else
+					s.playerHealth += s.wizardRegen;
+			}
+		}
+	}
+}
+
+void tick(GameState &s, Inputs const &inputs, float dt, JobSystem *jobs) {
+	PROFILE_ZONE("tick");
+
+	s.snap_previous();
+
+	for (Action action : inputs.actions) {
+		apply_action(s, action, dt);
+	}
+
+	//start generating the chunk the player is heading for, so it's ready when they get there:
+	if (s.streamer) {
+		ChunkCoord next = predicted_chunk(s);
+		if (!s.find(next)) s.streamer->request(next);
+	}
+
+	//scale per-tick amounts to the length of this tick:
+	float const rate = ReferenceTickRate * dt;
+
+	s.totalTime += dt;
+	s.ticks += 1;
+
+	//Constant decay on player
+	s.playerHealth -= s.healthDecay * rate;
+	s.playerTemp -= s.tempDecay * rate;
+
+	if (s.playerHealth <= 0.0f)
+		s.playerSpeed = 0.0f; //can't move if you're dead
+
+	//respawns (anywhere in the world) that are due:
+	s.timers.advance(s.ticks, [&s](uint64_t payload) {
+		respawn(s, Handle::unpack(payload));
+	});
+
+	//find the (full-grown) tree the player is standing at:
+	Screen &here = s.screens[s.screen];
+	s.treeCollideInstance = tree_at(here.trees, s.playerpos, s.treeBox, s.totalTime);
+
+	//animals chase the player and hurt on contact
+	// (partitions of entities update in parallel; shared state changes once they're done):
+	EntityTotals totals = update_entities(here.entities, s.playerpos, rate, jobs);
+	s.playerHealth -= totals.damage;
+}
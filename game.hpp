@@ -0,0 +1,183 @@
+#pragma once
+
+#include "entities.hpp"
+#include "jobs.hpp"
+#include "pool.hpp"
+#include "rng.hpp"
+#include "timer_wheel.hpp"
+
+#include <glm/glm.hpp>
+
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+
+/*
+ * Game state and simulation, independent of SDL and OpenGL so that it can be
+ * run headless (see headless.cpp) as well as from the windowed game.
+ */
+
+//Things the player can do; main.cpp maps keys onto these:
+enum class Action : uint8_t {
+	Up,         //w
+	Down,       //s
+	Left,       //a
+	Right,      //d
+	Attack,     //x: kill an adjacent animal / chop an adjacent tree
+	DropLumber, //f
+	EatMeat,    //e
+	Interact,   //c: harvest meat / trade with the wizard
+};
+
+//Everything the player did since the previous tick, in order:
+struct Inputs {
+	std::vector< Action > actions;
+};
+
+//where a screen-sized chunk of the world is, in screens from the one the player starts on (+x right, +y up):
+struct ChunkCoord {
+	int32_t x = 0;
+	int32_t y = 0;
+	//(for hashing and lookups)
+	uint64_t key() const { return (uint64_t(uint32_t(x)) << 32) | uint32_t(y); }
+	bool operator==(ChunkCoord const &other) const { return x == other.x && y == other.y; }
+	bool operator!=(ChunkCoord const &other) const { return !(*this == other); }
+};
+
+//set amounts of trees (per screen)
+constexpr int TreesPerScreen = 8;
+
+//what the player has changed in a chunk that regenerating it wouldn't give back: trees cut down and not grown back yet
+// (animals aren't included; killed ones respawn anyway, see Screen::respawning):
+struct ChunkDelta {
+	ChunkCoord coord;
+	uint32_t cut = 0; //bit per tree
+	float grown_at[TreesPerScreen] = {}; //for each tree in 'cut', when it is full-grown again
+};
+static_assert(TreesPerScreen <= 32, "ChunkDelta::cut has a bit per tree");
+//(by ChunkCoord::key())
+typedef std::unordered_map< uint64_t, ChunkDelta > ChunkDeltas;
+
+//one screen of the world:
+struct Screen {
+	ChunkCoord coord;
+	//animals killed here that haven't respawned yet (the chunk stays loaded until they have):
+	uint32_t respawning = 0;
+	//changes whenever anything here might have (a number from GameState::versions; not part of the
+	// simulation, just lets savers skip chunks they already have):
+	uint64_t version = 0;
+	Trees trees;
+	//animals (and maybe the wizard) living here; dead animals are removed until they respawn:
+	Entities entities;
+};
+
+//an animal waiting to respawn (what it needs to come back as itself):
+struct Respawn {
+	EntityKind kind;
+	ChunkCoord chunk; //(stays loaded until this comes back; see Screen::respawning)
+	Rng rng; //(its own stream carries on, so where it comes back doesn't depend on anything else)
+};
+
+struct ScreenStreamer;
+struct WorldSaver;
+
+struct GameState {
+	//an unbounded world of screen-sized chunks, each with 'animals' of each kind of animal and its own trees,
+	// placed randomly (plus the wizard); the same seed always gives the same world, and 'deltas' are
+	// changes already made to it (e.g. from load_world_deltas in world_save.hpp):
+	explicit GameState(uint32_t seed, uint32_t animals = 1, ChunkDeltas deltas = ChunkDeltas());
+
+	uint32_t seed;
+	uint32_t animals; //of each kind, per screen
+
+	//player position, and its value at the start of the latest tick (for drawing):
+	glm::vec2 playerpos = glm::vec2(0.0f, 0.0f);
+	glm::vec2 previous_playerpos = glm::vec2(0.0f, 0.0f);
+	//direction of the player's latest step along each axis (-1 or +1), 0 before the first:
+	glm::ivec2 heading = glm::ivec2(0, 0);
+
+	//the wizard never dies; it lives just right of the starting screen ('wizard' is valid while that chunk is loaded):
+	Handle wizard;
+	ChunkCoord wizard_chunk;
+
+	//the world goes on forever in every direction, but only some chunks are loaded: the player's, the last few
+	// they left (KeepRecent), and any with animals waiting to respawn. Any other chunk is generated again from
+	// scratch when the player gets there (see generate_screen), then has its delta applied. Only the player's
+	// screen needs updating every tick (trees regrow in closed form and respawns are timers):
+	static constexpr uint32_t KeepRecent = 4;
+	std::vector< Screen > screens; //loaded chunks, in no particular order
+	std::unordered_map< uint64_t, uint32_t > loaded; //ChunkCoord::key() -> index in screens
+	std::vector< ChunkCoord > left; //loaded chunks the player has left, least recently left first
+	//changes the player has made to chunks, loaded or not (a few bytes per changed chunk, however big the world):
+	ChunkDeltas deltas;
+	//index of the player's screen (begins on chunk (0, 0)):
+	uint32_t screen = 0;
+	//if set, chunks the player is heading for are generated ahead of time on its thread (see streaming.hpp);
+	// otherwise they are generated when the player enters them. The resulting state is the same either way:
+	ScreenStreamer *streamer = nullptr;
+	//if set, changes to 'deltas' are saved as they happen (see world_save.hpp):
+	WorldSaver *saver = nullptr;
+
+	//loaded screen at 'chunk', or null:
+	Screen *find(ChunkCoord const &chunk);
+	//source of Screen::version numbers (only ever goes up):
+	uint64_t versions = 0;
+
+	//dead animals, each with a timer (whose payload is its packed handle here) for when it respawns:
+	Pool< Respawn > respawns;
+	TimerWheel timers;
+
+	//player bound variables
+	float playerHealth = 1.0f;
+	float playerTemp = 1.0f;
+	//damage applied every tick from climate
+	float healthDecay = 0.00037f;
+	float tempDecay = 0.000037f;
+	//inventory
+	int lumber = 0;
+	int meat = 0;
+	//amount of health meat replaces
+	float meatRegen = 0.1f;
+	//replenish 75% of health when wizard is offered meat
+	float wizardRegen = 0.75f;
+
+	//full-grown tree the player is standing at (on the current screen), or -1
+	int32_t treeCollideInstance = -1;
+
+	//set initial speeds of interactable things
+	float playerSpeed = 0.05f;
+	float treeGrowRate = 0.0002f; //fraction of full height per reference tick
+
+	//each time an animal respawns, this grows by 1.5x
+	float boxSizeMultiplier = 1000.0f;
+	float treeBox = 0.05f;
+
+	//timer tracking total (simulated) time of current game session
+	float totalTime = 0.0f;
+	//number of ticks simulated so far
+	uint64_t ticks = 0;
+
+	//call after teleporting things so they don't visibly slide to their new spot
+	// (only touches the player and the current screen's entities):
+	void snap_previous();
+
+	//hash of the simulated state (bitwise), for checking that runs are reproducible:
+	uint64_t checksum() const;
+};
+
+//fill in chunk 'chunk' of the world with seed 'seed': 'animals' of each kind, trees, and (if 'wizard') the wizard, last.
+// Everything is drawn from generators seeded by a hash of the seed and the chunk's coordinates,
+// so this depends on nothing but its arguments, and can run on any thread:
+void generate_screen(uint32_t seed, ChunkCoord const &chunk, uint32_t animals, bool wizard, Screen *screen);
+
+//the chunk the player looks to be heading for (past the middle of this one, and last stepped towards
+// its edge; the nearer edge, if both), or the player's own chunk if none:
+ChunkCoord predicted_chunk(GameState const &state);
+
+//the per-tick amounts in GameState were tuned for this many updates per second:
+constexpr float ReferenceTickRate = 60.0f;
+
+//apply 'inputs', then advance the simulation by 'dt' seconds
+// (spreading entity updates over 'jobs', if given; dt should stay the same from tick to tick,
+// since timers are scheduled in ticks):
+void tick(GameState &state, Inputs const &inputs, float dt, JobSystem *jobs = nullptr);
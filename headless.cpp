@@ -0,0 +1,349 @@
+#include "game.hpp"
+#include "batch_aabb.hpp"
+#include "replay.hpp"
+#include "profiler.hpp"
+#include "memory_stats.hpp"
+#include "streaming.hpp"
+#include "world_save.hpp"
+#include "snapshot.hpp"
+#include "autosave.hpp"
+#include "rewind.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+
+/*
+ * Runs the game simulation without a window or GL context, as fast as it will go,
+ * and reports ticks per second. This is the baseline throughput number for
+ * simulation changes.
+ *
+ * With --replay, the inputs (and seed and tick rate) come from a replay
+ * file recorded by either this program or the windowed game.
+ *
+ * With --check-determinism <n>, the same session is run with 1, 2, ... n
+ * worker threads, and the state checksums (every CheckInterval ticks and
+ * at the end) must match bit-for-bit; exits with status 1 if they don't.
+ *
+ * Chunks of the world are generated ahead of the player on a streaming
+ * thread (see streaming.hpp) unless --no-streaming is given; results are
+ * the same either way.
+ *
+ * With --load <file>, the run continues from a snapshot (see snapshot.hpp)
+ * instead of starting a new game; with --save <file>, the final state is
+ * saved as one. Saving after n ticks and loading to run m more ends in
+ * the same state as running n + m.
+ *
+ * With --world <file>, changes to the world are loaded from (if it exists)
+ * and saved to that file as they happen (see world_save.hpp).
+ *
+ * With --autosave <file>, a snapshot is saved there in the background
+ * every --autosave-every ticks (see autosave.hpp), and the cost on the
+ * simulation thread is reported. (Autosaves allocate, so the heap
+ * allocation count after warm-up is only zero without them.)
+ *
+ * With --rewind <seconds>, the latest ticks are kept in a rewind buffer
+ * (see rewind.hpp) of at most --rewind-budget megabytes. At the end the
+ * game is stepped back through them, timing each rewind. Then it is run
+ * forward again from the oldest one, and must reach the same checksum.
+ * With --world, the world file must match the rewound state too.
+ *
+ * With --memory-report <file>, live / peak heap bytes per subsystem are
+ * written there as JSON at the end of the run (for CI to track).
+ */
+
+//Configuration:
+struct Config {
+	uint64_t ticks = 1000000;
+	float tick_rate = 60.0f;
+	bool idle = false; //don't feed any scripted inputs
+	uint32_t seed = 0;
+	uint32_t animals = 1; //of each kind, per screen
+	uint32_t workers = 1; //job system threads; 0 means one per hardware thread
+	uint32_t check_determinism = 0; //if nonzero, compare runs with 1..this many workers
+	bool streaming = true; //generate chunks ahead on a background thread
+	std::string record;
+	std::string replay;
+	std::string memory_report;
+	std::string world;
+	std::string load; //snapshot to start from
+	std::string save; //snapshot to write at the end
+	std::string autosave; //snapshot to write every autosave_every ticks
+	uint64_t autosave_every = 600; //(ten seconds at the default tick rate)
+	float rewind_seconds = 0.0f; //keep this many seconds of ticks to rewind through at the end
+	uint64_t rewind_budget = 16; //megabytes (as in main)
+};
+
+//ticks between the checksums compared by --check-determinism:
+static constexpr uint64_t CheckInterval = 1000;
+
+//run the whole session on 'state'; returns seconds taken, and (if 'trace' isn't null) a hash of the checksums every CheckInterval ticks in it;
+// heap allocations made after the first tenth of the ticks (by which point they should have stopped) go in 'steady_allocations':
+static float simulate(Config const &config, Replay *replay, ReplayRecorder *recorder, Autosaver *autosaver, RewindBuffer *rewind, JobSystem &jobs, GameState &state, uint64_t *trace, uint64_t *steady_allocations) {
+	Inputs inputs;
+	float const tick_length = 1.0f / config.tick_rate;
+	if (trace) *trace = 0;
+	uint64_t const warmup = config.ticks / 10;
+	uint64_t heap_before = heap_allocations();
+
+	auto before = std::chrono::steady_clock::now();
+	for (uint64_t t = 0; t < config.ticks; ++t) {
+		if (t == warmup) heap_before = heap_allocations();
+		inputs.actions.clear();
+		if (replay) {
+			replay->inputs_for(state.ticks, &inputs);
+		} else if (!config.idle) {
+			//scripted input: every few ticks, pace back and forth across the chunks around the start,
+			// attacking and interacting with whatever is nearby (by game tick, so it carries on from a snapshot):
+			uint64_t step = state.ticks / 4;
+			if (state.ticks % 4 == 0) {
+				uint64_t phase = step % 200;
+				inputs.actions.emplace_back(phase < 100 ? Action::Right : Action::Left);
+				if (step % 7 == 0) inputs.actions.emplace_back(Action::Attack);
+				if (step % 11 == 0) inputs.actions.emplace_back(Action::Interact);
+				if (step % 13 == 0) inputs.actions.emplace_back(Action::EatMeat);
+			}
+		}
+		if (recorder) recorder->record(t, inputs);
+		tick(state, inputs, tick_length, &jobs);
+		if (autosaver) autosaver->update(state);
+		if (rewind) rewind->record(state);
+		if (trace && (t + 1) % CheckInterval == 0) {
+			*trace = (*trace ^ state.checksum()) * 0x100000001b3ULL;
+		}
+	}
+	auto after = std::chrono::steady_clock::now();
+	*steady_allocations = heap_allocations() - heap_before;
+	return std::chrono::duration< float >(after - before).count();
+}
+
+int main(int argc, char **argv) {
+	Config config;
+	bool animals_given = false; //(replays bring their own)
+
+	for (int argi = 1; argi < argc; ++argi) {
+		if (std::strcmp(argv[argi], "--ticks") == 0 && argi + 1 < argc) {
+			config.ticks = std::strtoull(argv[++argi], nullptr, 10);
+		} else if (std::strcmp(argv[argi], "--tick-rate") == 0 && argi + 1 < argc) {
+			config.tick_rate = float(std::atof(argv[++argi]));
+			if (!(config.tick_rate > 0.0f)) {
+				std::cerr << "--tick-rate must be positive." << std::endl;
+				return 1;
+			}
+		} else if (std::strcmp(argv[argi], "--idle") == 0) {
+			config.idle = true;
+		} else if (std::strcmp(argv[argi], "--seed") == 0 && argi + 1 < argc) {
+			config.seed = uint32_t(std::strtoul(argv[++argi], nullptr, 10));
+		} else if (std::strcmp(argv[argi], "--animals") == 0 && argi + 1 < argc) {
+			config.animals = uint32_t(std::strtoul(argv[++argi], nullptr, 10));
+			animals_given = true;
+		} else if (std::strcmp(argv[argi], "--workers") == 0 && argi + 1 < argc) {
+			config.workers = uint32_t(std::strtoul(argv[++argi], nullptr, 10));
+		} else if (std::strcmp(argv[argi], "--check-determinism") == 0 && argi + 1 < argc) {
+			config.check_determinism = uint32_t(std::strtoul(argv[++argi], nullptr, 10));
+		} else if (std::strcmp(argv[argi], "--simd") == 0 && argi + 1 < argc) {
+			std::string level = argv[++argi];
+			if (level == "scalar") simd_limit(SimdLevel::Scalar);
+			else if (level == "sse2") simd_limit(SimdLevel::SSE2);
+			else if (level == "avx2") simd_limit(SimdLevel::AVX2);
+			else {
+				std::cerr << "--simd takes scalar, sse2 or avx2." << std::endl;
+				return 1;
+			}
+		} else if (std::strcmp(argv[argi], "--record") == 0 && argi + 1 < argc) {
+			config.record = argv[++argi];
+		} else if (std::strcmp(argv[argi], "--replay") == 0 && argi + 1 < argc) {
+			config.replay = argv[++argi];
+		} else if (std::strcmp(argv[argi], "--no-streaming") == 0) {
+			config.streaming = false;
+		} else if (std::strcmp(argv[argi], "--memory-report") == 0 && argi + 1 < argc) {
+			config.memory_report = argv[++argi];
+		} else if (std::strcmp(argv[argi], "--world") == 0 && argi + 1 < argc) {
+			config.world = argv[++argi];
+		} else if (std::strcmp(argv[argi], "--load") == 0 && argi + 1 < argc) {
+			config.load = argv[++argi];
+		} else if (std::strcmp(argv[argi], "--save") == 0 && argi + 1 < argc) {
+			config.save = argv[++argi];
+		} else if (std::strcmp(argv[argi], "--autosave") == 0 && argi + 1 < argc) {
+			config.autosave = argv[++argi];
+		} else if (std::strcmp(argv[argi], "--autosave-every") == 0 && argi + 1 < argc) {
+			config.autosave_every = std::strtoull(argv[++argi], nullptr, 10);
+			if (config.autosave_every == 0) {
+				std::cerr << "--autosave-every must be at least one tick." << std::endl;
+				return 1;
+			}
+		} else if (std::strcmp(argv[argi], "--rewind") == 0 && argi + 1 < argc) {
+			config.rewind_seconds = float(std::atof(argv[++argi]));
+		} else if (std::strcmp(argv[argi], "--rewind-budget") == 0 && argi + 1 < argc) {
+			config.rewind_budget = std::strtoull(argv[++argi], nullptr, 10);
+		} else {
+			std::cerr << "Usage:\n\t" << argv[0] << " [--ticks <n>] [--tick-rate <hz>] [--idle] [--seed <n>] [--animals <n>] [--workers <n>] [--check-determinism <max workers>] [--no-streaming] [--simd scalar|sse2|avx2] [--record <file> | --replay <file>] [--world <file>] [--load <file>] [--save <file>] [--autosave <file> [--autosave-every <ticks>]] [--rewind <seconds> [--rewind-budget <MB>]] [--memory-report <file>]" << std::endl;
+			return 1;
+		}
+	}
+
+	Replay replay;
+	bool replaying = !config.replay.empty();
+	if (replaying) {
+		if (!replay.load(config.replay)) return 1;
+		if (animals_given) {
+			std::cerr << "Replays bring their own number of animals; --animals can't be combined with --replay." << std::endl;
+			return 1;
+		}
+		config.seed = replay.seed;
+		config.animals = replay.animals;
+		config.tick_rate = replay.tick_rate;
+		config.ticks = replay.ticks;
+	}
+	if (config.check_determinism && !(config.record.empty() && config.world.empty() && config.load.empty() && config.save.empty() && config.autosave.empty() && config.rewind_seconds <= 0.0f)) {
+		std::cerr << "--check-determinism runs the session several times; it can't also --record, --load, --save, --autosave, --rewind or save a --world." << std::endl;
+		return 1;
+	}
+	if (!config.load.empty() && (replaying || !config.record.empty())) {
+		std::cerr << "Replays start from a new game; they can't be combined with --load." << std::endl;
+		return 1;
+	}
+	if (!config.world.empty() && (replaying || !config.record.empty())) {
+		//(recording would append its own changes to the world file, so the replay would start from a different world)
+		std::cerr << "Replays start from an unchanged world; they can't be combined with --world." << std::endl;
+		return 1;
+	}
+	ChunkDeltas deltas;
+	uint32_t world_seed = config.seed;
+	if (!config.world.empty()) {
+		if (!load_world_deltas(config.world, &world_seed, &deltas)) return 1;
+		if (config.load.empty() && world_seed != config.seed) {
+			std::cerr << "'" << config.world << "' holds changes to the world with seed " << world_seed << ", not " << config.seed << "." << std::endl;
+			return 1;
+		}
+	}
+	bool world_changed = !deltas.empty();
+	std::unique_ptr< ReplayRecorder > recorder;
+	if (!config.record.empty()) {
+		recorder.reset(new ReplayRecorder(config.record, config.seed, config.animals, config.tick_rate));
+	}
+
+	PROFILE_THREAD_NAME("main");
+
+	if (config.check_determinism) {
+		//same session at each worker count; everything must match the single-threaded run:
+		uint64_t expected_trace = 0, expected_checksum = 0;
+		bool matched = true;
+		for (uint32_t workers = 1; workers <= config.check_determinism; ++workers) {
+			JobSystem jobs(workers);
+			GameState state(config.seed, config.animals);
+			std::unique_ptr< ScreenStreamer > streamer;
+			if (config.streaming) {
+				streamer.reset(new ScreenStreamer(state));
+				state.streamer = streamer.get();
+			}
+			Replay session = replay; //(own copy, since replays track their position)
+			uint64_t trace = 0, steady_allocations = 0;
+			float seconds = simulate(config, replaying ? &session : nullptr, nullptr, nullptr, nullptr, jobs, state, &trace, &steady_allocations);
+			uint64_t checksum = state.checksum();
+			if (workers == 1) {
+				expected_trace = trace;
+				expected_checksum = checksum;
+			}
+			bool same = (trace == expected_trace && checksum == expected_checksum);
+			matched = matched && same;
+			std::cout << workers << " worker" << (workers == 1 ? "" : "s") << ": checksum " << std::hex << checksum
+			          << ", trace " << trace << std::dec << " (" << seconds << " s)"
+			          << (same ? "" : " MISMATCH") << std::endl;
+		}
+		std::cout << (matched ? "Deterministic" : "NOT deterministic") << " across 1 to " << config.check_determinism << " workers." << std::endl;
+		return matched ? 0 : 1;
+	}
+
+	JobSystem jobs(config.workers);
+	GameState state(config.seed, config.animals, std::move(deltas));
+	if (!config.load.empty()) {
+		//(the snapshot has its own deltas, and they have to be of the same world as any in the world file)
+		auto before = std::chrono::steady_clock::now();
+		if (!load_snapshot(config.load, &state)) return 1;
+		std::cout << "Loaded snapshot '" << config.load << "' (tick " << state.ticks << ") in "
+		          << std::chrono::duration< double >(std::chrono::steady_clock::now() - before).count() * 1000.0 << " ms." << std::endl;
+		if (world_changed && world_seed != state.seed) {
+			std::cerr << "'" << config.world << "' holds changes to the world with seed " << world_seed << ", not the snapshot's " << state.seed << "." << std::endl;
+			return 1;
+		}
+	}
+	std::unique_ptr< ScreenStreamer > streamer;
+	if (config.streaming) {
+		streamer.reset(new ScreenStreamer(state));
+		state.streamer = streamer.get();
+	}
+	std::unique_ptr< WorldSaver > saver;
+	if (!config.world.empty()) {
+		saver.reset(new WorldSaver(config.world, state));
+		state.saver = saver.get();
+	}
+	std::unique_ptr< Autosaver > autosaver;
+	if (!config.autosave.empty()) {
+		autosaver.reset(new Autosaver(config.autosave, config.autosave_every));
+	}
+	std::unique_ptr< RewindBuffer > rewind;
+	if (config.rewind_seconds > 0.0f) {
+		rewind.reset(new RewindBuffer(uint64_t(config.rewind_seconds * config.tick_rate), size_t(config.rewind_budget) * 1024 * 1024));
+	}
+	uint64_t steady_allocations = 0;
+	float seconds = simulate(config, replaying ? &replay : nullptr, recorder.get(), autosaver.get(), rewind.get(), jobs, state, nullptr, &steady_allocations);
+	if (recorder) recorder->finish(config.ticks);
+	if (autosaver) autosaver->wait();
+	if (rewind && !rewind->empty()) {
+		//step back through the kept ticks, then play forward again from the oldest; the end should be the same:
+		uint64_t const end = state.ticks, end_checksum = state.checksum();
+		uint64_t const oldest = rewind->oldest(), newest = rewind->newest();
+		for (uint32_t step = 1; step <= 8; ++step) {
+			if (!rewind->rewind(newest - (newest - oldest) * step / 8, &state)) return 1;
+		}
+		if (saver) {
+			//(rewinding rewrites the world file from the rewound state's deltas; running forward again cuts the same
+			// trees, so this is the only point where a stale file would show)
+			uint32_t saved_seed = 0;
+			ChunkDeltas saved;
+			bool same = load_world_deltas(config.world, &saved_seed, &saved, state.totalTime) && saved.size() == state.deltas.size();
+			for (auto const &entry : state.deltas) {
+				auto found = saved.find(entry.first);
+				same = same && found != saved.end() && found->second.cut == entry.second.cut;
+			}
+			std::cout << "World file after rewinding: " << (same ? "matches the rewound state." : "MISMATCH.") << std::endl;
+			if (!same) return 1;
+		}
+		Config again = config;
+		again.ticks = end - state.ticks;
+		uint64_t ignored = 0;
+		simulate(again, replaying ? &replay : nullptr, nullptr, nullptr, nullptr, jobs, state, nullptr, &ignored);
+		bool same = (state.ticks == end && state.checksum() == end_checksum);
+		std::cout << "Rewound from tick " << end << " to " << oldest << " in 8 steps, then ran forward again: checksum "
+		          << (same ? "matches." : "MISMATCH.") << std::endl;
+		if (!same) return 1;
+	}
+	if (saver) saver->finish(state.totalTime);
+	if (!config.save.empty()) {
+		auto before = std::chrono::steady_clock::now();
+		if (!save_snapshot(state, config.save)) return 1;
+		std::cout << "Saved snapshot '" << config.save << "' in "
+		          << std::chrono::duration< double >(std::chrono::steady_clock::now() - before).count() * 1000.0 << " ms." << std::endl;
+	}
+
+	std::cout << "Ran " << config.ticks << " ticks in " << seconds << " s ("
+	          << (seconds > 0.0f ? float(config.ticks) / seconds : 0.0f) << " ticks/s, " << simd_name(simd_best()) << " kernels)." << std::endl;
+	std::cout << "Final state: health " << state.playerHealth << ", temperature " << state.playerTemp
+	          << ", meat " << state.meat << ", lumber " << state.lumber
+	          << ", player at (" << state.playerpos.x << ", " << state.playerpos.y << ")." << std::endl;
+	std::cout << "State checksum: " << std::hex << state.checksum() << std::dec << std::endl;
+	std::cout << "Heap allocations after warm-up (the first " << config.ticks / 10 << " ticks): " << steady_allocations << std::endl;
+	std::cout << "Memory:\n";
+	memory_report(std::cout);
+	jobs.report(std::cout);
+	if (streamer) streamer->report(std::cout);
+	if (saver) saver->report(std::cout);
+	if (autosaver) autosaver->report(std::cout);
+	if (rewind) rewind->report(std::cout);
+	if (!config.memory_report.empty() && !memory_write_report(config.memory_report)) return 1;
+
+	return 0;
+}
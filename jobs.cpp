@@ -0,0 +1,186 @@
+#include "jobs.hpp"
+#include "profiler.hpp"
+#include "memory_stats.hpp"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+//which worker (of which system) the calling thread is:
+static thread_local JobSystem const *current_system = nullptr;
+static thread_local uint32_t current_index = 0;
+
+static int64_t now_ns() {
+	return std::chrono::duration_cast< std::chrono::nanoseconds >(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+JobSystem::JobSystem(uint32_t count) {
+	if (count == 0) count = std::max(1u, std::thread::hardware_concurrency());
+	MemTagScope tag(MemTag::Jobs);
+	for (uint32_t i = 0; i < count; ++i) {
+		workers.emplace_back(new Worker);
+	}
+	current_system = this;
+	current_index = 0;
+	stats_start_ns = now_ns();
+	for (uint32_t i = 1; i < count; ++i) {
+		threads.emplace_back(&JobSystem::worker_main, this, i);
+	}
+}
+
+JobSystem::~JobSystem() {
+	{
+		std::lock_guard< std::mutex > guard(sleep_lock);
+		quit = true;
+	}
+	wake.notify_all();
+	for (auto &thread : threads) {
+		thread.join();
+	}
+	if (current_system == this) current_system = nullptr;
+}
+
+uint32_t JobSystem::current_worker() const {
+	return (current_system == this ? current_index : 0);
+}
+
+void JobSystem::push(Job const &job) {
+	Worker &worker = *workers[current_worker()];
+	{
+		std::lock_guard< std::mutex > guard(worker.lock);
+		worker.jobs.push_back(job);
+	}
+	queued.fetch_add(1);
+	//(taking sleep_lock means a worker can't miss this between checking 'queued' and sleeping)
+	{
+		std::lock_guard< std::mutex > guard(sleep_lock);
+	}
+	wake.notify_one();
+}
+
+void JobSystem::schedule_after(Counter &dependency, Job const &job) {
+	{
+		std::lock_guard< std::mutex > guard(dependency.lock);
+		if (dependency.pending.load() != 0) {
+			dependency.continuations.emplace_back(job);
+			return;
+		}
+	}
+	push(job);
+}
+
+void JobSystem::finish(Job const &job) {
+	Counter *counter = job.counter;
+	if (!counter) return;
+	//(decrement under the lock, so a waiter that saw zero and then took the lock knows this is done with 'counter')
+	std::vector< Job > ready;
+	{
+		std::lock_guard< std::mutex > guard(counter->lock);
+		if (counter->pending.fetch_sub(1) != 1) return;
+		//reached zero; release anything waiting on it:
+		ready.swap(counter->continuations);
+	}
+	for (Job const &next : ready) {
+		push(next);
+	}
+}
+
+//run one job from worker 'index's own deque (newest first) or stolen from another's (oldest first):
+bool JobSystem::try_run(uint32_t index) {
+	if (queued.load() == 0) return false;
+
+	Job job;
+	bool found = false;
+	bool stolen = false;
+	{
+		Worker &own = *workers[index];
+		std::lock_guard< std::mutex > guard(own.lock);
+		if (!own.jobs.empty()) {
+			job = own.jobs.pop_back();
+			found = true;
+		}
+	}
+	for (uint32_t offset = 1; !found && offset < workers.size(); ++offset) {
+		Worker &victim = *workers[(index + offset) % workers.size()];
+		std::lock_guard< std::mutex > guard(victim.lock);
+		if (!victim.jobs.empty()) {
+			job = victim.jobs.pop_front();
+			found = stolen = true;
+		}
+	}
+	if (!found) return false;
+	queued.fetch_sub(1);
+
+	Worker &worker = *workers[index];
+	int64_t before = now_ns();
+	job.fn(job.data, job.begin, job.end);
+	worker.busy_ns.fetch_add(uint64_t(now_ns() - before), std::memory_order_relaxed);
+	worker.jobs_run.fetch_add(1, std::memory_order_relaxed);
+	if (stolen) worker.steals.fetch_add(1, std::memory_order_relaxed);
+
+	finish(job);
+	return true;
+}
+
+void JobSystem::wait(Counter &counter) {
+	PROFILE_ZONE("wait for jobs");
+	uint32_t index = current_worker();
+	while (counter.pending.load() != 0) {
+		if (!try_run(index)) std::this_thread::yield();
+	}
+	//(the last job to finish may still hold the lock; the caller is free to destroy 'counter' after this)
+	std::lock_guard< std::mutex > guard(counter.lock);
+}
+
+void JobSystem::worker_main(uint32_t index) {
+#ifdef PROFILER_ENABLED
+	static char const *names[] = {"worker 0", "worker 1", "worker 2", "worker 3", "worker 4", "worker 5", "worker 6", "worker 7"};
+	PROFILE_THREAD_NAME(index < 8 ? names[index] : "worker");
+#endif
+	current_system = this;
+	current_index = index;
+
+	while (true) {
+		if (try_run(index)) continue;
+		std::unique_lock< std::mutex > guard(sleep_lock);
+		wake.wait(guard, [this](){ return quit.load() || queued.load() != 0; });
+		if (quit) break;
+	}
+}
+
+std::vector< JobSystem::WorkerStats > JobSystem::stats() const {
+	std::vector< WorkerStats > result;
+	for (auto const &worker : workers) {
+		WorkerStats s;
+		s.jobs = worker->jobs_run.load();
+		s.steals = worker->steals.load();
+		s.busy = double(worker->busy_ns.load()) * 1e-9;
+		result.emplace_back(s);
+	}
+	return result;
+}
+
+double JobSystem::elapsed() const {
+	return double(now_ns() - stats_start_ns.load()) * 1e-9;
+}
+
+void JobSystem::reset_stats() {
+	for (auto &worker : workers) {
+		worker->jobs_run = 0;
+		worker->steals = 0;
+		worker->busy_ns = 0;
+	}
+	stats_start_ns = now_ns();
+}
+
+void JobSystem::report(std::ostream &out) const {
+	double wall = elapsed();
+	std::vector< WorkerStats > all = stats();
+	out << "Job system: " << all.size() << " workers over " << std::fixed << std::setprecision(3) << wall << " s.\n";
+	for (uint32_t i = 0; i < all.size(); ++i) {
+		out << "  worker " << i << ": " << all[i].jobs << " jobs (" << all[i].steals << " stolen), busy "
+		    << std::setprecision(3) << all[i].busy << " s ("
+		    << std::setprecision(1) << (wall > 0.0 ? 100.0 * all[i].busy / wall : 0.0) << "%)\n";
+	}
+	out << std::defaultfloat << std::flush;
+}
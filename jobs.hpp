@@ -0,0 +1,202 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+/*
+ * Work-stealing job system.
+ *
+ * There is one worker per thread, including the thread that created the
+ * JobSystem (worker 0, which only runs jobs while it is inside wait()).
+ * Each worker has its own deque: it pushes and pops its own jobs at the
+ * back, and idle workers steal from the front of other workers' deques.
+ *
+ * Completion is tracked with Counters: run() bumps a counter, the job
+ * finishing drops it, and wait() helps run jobs until it reaches zero.
+ * run_after() makes a job depend on a counter instead of blocking on it.
+ *
+ * The same pool is used for startup asset decoding and for per-tick
+ * entity updates; stats() and report() show how busy each worker was.
+ */
+
+struct JobSystem {
+	//'workers' threads in total (including the calling thread); 0 means one per hardware thread:
+	explicit JobSystem(uint32_t workers = 0);
+	~JobSystem();
+	JobSystem(JobSystem const &) = delete;
+	JobSystem &operator=(JobSystem const &) = delete;
+
+	struct Counter;
+
+	struct Job {
+		void (*fn)(void *data, uint32_t begin, uint32_t end);
+		void *data;
+		uint32_t begin, end;
+		Counter *counter; //dropped when the job finishes (may be null)
+	};
+
+	//number of jobs still to finish; also holds jobs waiting for it to reach zero:
+	struct Counter {
+		std::atomic< uint32_t > pending{0};
+		std::mutex lock;
+		std::vector< Job > continuations; //(guarded by lock)
+	};
+
+	//queue 'job' (a callable taking no arguments) on the calling worker:
+	template< typename F >
+	void run(F const &job, Counter *counter = nullptr);
+	//queue 'job' once 'dependency' reaches zero (right away if it already has):
+	template< typename F >
+	void run_after(Counter &dependency, F const &job, Counter *counter = nullptr);
+	//run queued jobs on this thread until 'counter' reaches zero:
+	void wait(Counter &counter);
+
+	//call body(begin, end) over [begin, end) split into pieces of at most 'grain'
+	// (rounded so every piece except the last starts and ends on a multiple of 'grain'),
+	// and return once all pieces are done:
+	template< typename F >
+	void parallel_for(uint32_t begin, uint32_t end, uint32_t grain, F const &body);
+
+	uint32_t worker_count() const { return uint32_t(workers.size()); }
+	//index of the calling thread's worker (threads outside the pool count as worker 0):
+	uint32_t current_worker() const;
+
+	struct WorkerStats {
+		uint64_t jobs; //jobs run
+		uint64_t steals; //of those, jobs taken from another worker's deque
+		double busy; //seconds spent running jobs
+	};
+	std::vector< WorkerStats > stats() const;
+	//seconds since construction or the last reset_stats():
+	double elapsed() const;
+	void reset_stats();
+	//per-worker jobs, steals and utilisation (busy / elapsed):
+	void report(std::ostream &out) const;
+
+	//------------ internals ------------
+	//double-ended ring of jobs; grows by doubling, and never shrinks, so steady-state pushes don't allocate:
+	struct JobQueue {
+		std::vector< Job > ring;
+		uint32_t first = 0;
+		uint32_t count = 0;
+
+		bool empty() const { return count == 0; }
+		void push_back(Job const &job) {
+			if (count == ring.size()) grow();
+			ring[(first + count) & (ring.size() - 1)] = job;
+			++count;
+		}
+		Job pop_back() {
+			--count;
+			return ring[(first + count) & (ring.size() - 1)];
+		}
+		Job pop_front() {
+			Job job = ring[first];
+			first = (first + 1) & (ring.size() - 1);
+			--count;
+			return job;
+		}
+		void grow() {
+			std::vector< Job > bigger(ring.empty() ? 64 : 2 * ring.size());
+			for (uint32_t i = 0; i < count; ++i) {
+				bigger[i] = ring[(first + i) & (ring.size() - 1)];
+			}
+			ring.swap(bigger);
+			first = 0;
+		}
+	};
+	struct Worker {
+		std::mutex lock;
+		JobQueue jobs; //(guarded by lock)
+		std::atomic< uint64_t > jobs_run{0};
+		std::atomic< uint64_t > steals{0};
+		std::atomic< uint64_t > busy_ns{0};
+		char padding[64]; //keep workers' counters off each other's cache lines
+	};
+	std::vector< std::unique_ptr< Worker > > workers;
+	std::vector< std::thread > threads;
+
+	std::atomic< uint32_t > queued{0}; //jobs sitting in deques
+	std::atomic< bool > quit{false};
+	std::mutex sleep_lock;
+	std::condition_variable wake;
+	std::atomic< int64_t > stats_start_ns{0};
+
+	void push(Job const &job);
+	void finish(Job const &job);
+	bool try_run(uint32_t index);
+	void worker_main(uint32_t index);
+	void schedule_after(Counter &dependency, Job const &job);
+};
+
+template< typename F >
+void JobSystem::run(F const &job, Counter *counter) {
+	//the job owns a copy of 'job', deleted once it has run:
+	Job j;
+	j.fn = [](void *data, uint32_t, uint32_t) {
+		F *f = reinterpret_cast< F * >(data);
+		(*f)();
+		delete f;
+	};
+	j.data = new F(job);
+	j.begin = j.end = 0;
+	j.counter = counter;
+	if (counter) counter->pending.fetch_add(1);
+	push(j);
+}
+
+template< typename F >
+void JobSystem::run_after(Counter &dependency, F const &job, Counter *counter) {
+	Job j;
+	j.fn = [](void *data, uint32_t, uint32_t) {
+		F *f = reinterpret_cast< F * >(data);
+		(*f)();
+		delete f;
+	};
+	j.data = new F(job);
+	j.begin = j.end = 0;
+	j.counter = counter;
+	if (counter) counter->pending.fetch_add(1);
+	schedule_after(dependency, j);
+}
+
+template< typename F >
+void JobSystem::parallel_for(uint32_t begin, uint32_t end, uint32_t grain, F const &body) {
+	if (begin >= end) return;
+	if (grain == 0) grain = 1;
+	uint32_t first_end = std::min(end, (begin / grain + 1) * grain);
+	if (first_end == end || workers.size() == 1) {
+		//(same pieces as below, just run here)
+		body(begin, first_end);
+		for (uint32_t b = first_end; b < end; b += grain) {
+			body(b, std::min(end, b + grain));
+		}
+		return;
+	}
+	//pieces only reference 'body', which outlives them since this waits:
+	Counter counter;
+	Job j;
+	j.fn = [](void *data, uint32_t b, uint32_t e) {
+		(*reinterpret_cast< F const * >(data))(b, e);
+	};
+	j.data = const_cast< F * >(&body);
+	j.counter = &counter;
+	counter.pending.fetch_add(1);
+	j.begin = begin;
+	j.end = first_end;
+	push(j);
+	for (uint32_t b = first_end; b < end; b += grain) {
+		counter.pending.fetch_add(1);
+		j.begin = b;
+		j.end = std::min(end, b + grain);
+		push(j);
+	}
+	wait(counter);
+}
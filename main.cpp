@@ -1,28 +1,243 @@
 #include "load_save_png.hpp"
+#include "profiler.hpp"
+#include "startup_timeline.hpp"
+#include "program_cache.hpp"
+#include "game.hpp"
+#include "replay.hpp"
+#include "world_save.hpp"
+#include "snapshot.hpp"
+#include "autosave.hpp"
+#include "rewind.hpp"
+#include "jobs.hpp"
+#include "frame_arena.hpp"
+#include "memory_stats.hpp"
+#include "texture_cache.hpp"
+#include "streaming.hpp"
 #include "GL.hpp"
 
 #include <SDL.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
 #include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <memory>
 #include <stdexcept>
 
 static GLuint compile_shader(GLenum type, std::string const &source);
-static GLuint link_program(GLuint vertex_shader, GLuint fragment_shader);
+static GLuint link_program(GLuint fragment_shader, GLuint vertex_shader, ProgramCache const *cache = nullptr);
 
 int main(int argc, char **argv) {
+	//track time from launch to first frame:
+	StartupTimeline startup;
+
 	//Configuration:
 	struct {
 		std::string title = "Game1: Text/Tiles";
 		glm::uvec2 size = glm::uvec2(640, 640);
+		bool exit_after_first_frame = false; //for timing cold/warm startup from scripts
+		float tick_rate = 60.0f; //simulation ticks per second (independent of display rate)
+		std::string record; //if set, log inputs to this replay file
+		std::string replay; //if set, play inputs back from this replay file (then quit)
+		uint32_t workers = 0; //job system threads (including this one); 0 means one per hardware thread
+		std::string memory_report; //if set, write memory stats (JSON) here on exit
+		uint64_t texture_budget = 16 * 1024 * 1024; //bytes of sprite textures to keep resident
+		std::string world; //if set, load changes to the world from here (if it exists) and save them here as they happen
+		std::string load; //if set, start from this snapshot instead of a new game
+		std::string quicksave = "quicksave.snap"; //snapshot F5 saves to and F8 loads from
+		std::string autosave; //if set, save a snapshot here (in the background) every autosave_seconds of game time
+		float autosave_seconds = 10.0f;
+		float rewind_seconds = 10.0f; //keep this many seconds of ticks for Backspace to step back through (0 to turn off)
+		uint64_t rewind_budget = 16 * 1024 * 1024; //bytes the rewind buffer may use
 	} config;
 
+	for (int argi = 1; argi < argc; ++argi) {
+		if (std::strcmp(argv[argi], "--exit-after-first-frame") == 0) {
+			config.exit_after_first_frame = true;
+		} else if (std::strcmp(argv[argi], "--tick-rate") == 0 && argi + 1 < argc) {
+			config.tick_rate = float(std::atof(argv[++argi]));
+			if (!(config.tick_rate > 0.0f)) {
+				std::cerr << "--tick-rate must be positive." << std::endl;
+				return 1;
+			}
+		} else if (std::strcmp(argv[argi], "--record") == 0 && argi + 1 < argc) {
+			config.record = argv[++argi];
+		} else if (std::strcmp(argv[argi], "--replay") == 0 && argi + 1 < argc) {
+			config.replay = argv[++argi];
+		} else if (std::strcmp(argv[argi], "--workers") == 0 && argi + 1 < argc) {
+			config.workers = uint32_t(std::strtoul(argv[++argi], nullptr, 10));
+		} else if (std::strcmp(argv[argi], "--texture-budget") == 0 && argi + 1 < argc) {
+			config.texture_budget = std::strtoull(argv[++argi], nullptr, 10) * 1024;
+		} else if (std::strcmp(argv[argi], "--memory-report") == 0 && argi + 1 < argc) {
+			config.memory_report = argv[++argi];
+		} else if (std::strcmp(argv[argi], "--world") == 0 && argi + 1 < argc) {
+			config.world = argv[++argi];
+		} else if (std::strcmp(argv[argi], "--load") == 0 && argi + 1 < argc) {
+			config.load = argv[++argi];
+		} else if (std::strcmp(argv[argi], "--quicksave") == 0 && argi + 1 < argc) {
+			config.quicksave = argv[++argi];
+		} else if (std::strcmp(argv[argi], "--autosave") == 0 && argi + 1 < argc) {
+			config.autosave = argv[++argi];
+		} else if (std::strcmp(argv[argi], "--rewind-seconds") == 0 && argi + 1 < argc) {
+			config.rewind_seconds = float(std::atof(argv[++argi]));
+		} else if (std::strcmp(argv[argi], "--rewind-budget") == 0 && argi + 1 < argc) {
+			config.rewind_budget = std::strtoull(argv[++argi], nullptr, 10) * 1024 * 1024;
+		} else {
+			std::cerr << "Usage:\n\t" << argv[0] << " [--exit-after-first-frame] [--tick-rate <hz>] [--workers <n>] [--texture-budget <KB>] [--record <file> | --replay <file>] [--world <file>] [--load <file>] [--quicksave <file>] [--autosave <file>] [--rewind-seconds <s>] [--rewind-budget <MB>] [--memory-report <file>]" << std::endl;
+			return 1;
+		}
+	}
+
+	//inputs come from the replay rather than the keyboard, if one was given:
+	Replay replay;
+	bool replaying = !config.replay.empty();
+	uint32_t seed = uint32_t(std::chrono::system_clock::now().time_since_epoch().count());
+	uint32_t animals = 1; //of each kind, per screen
+	if (replaying) {
+		if (!replay.load(config.replay)) return 1;
+		seed = replay.seed;
+		animals = replay.animals;
+		config.tick_rate = replay.tick_rate;
+	}
+	if (!config.load.empty() && (replaying || !config.record.empty())) {
+		std::cerr << "Replays start from a new game; they can't be combined with --load." << std::endl;
+		return 1;
+	}
+	if (!config.world.empty() && (replaying || !config.record.empty())) {
+		//(recording would append its own changes to the world file, so the replay would start from a different world)
+		std::cerr << "Replays start from an unchanged world; they can't be combined with --world." << std::endl;
+		return 1;
+	}
+	//a saved world brings its own seed (the changes only make sense on top of the world they were made in):
+	ChunkDeltas deltas;
+	if (!config.world.empty()) {
+		uint32_t world_seed = seed;
+		if (!load_world_deltas(config.world, &world_seed, &deltas)) return 1;
+		seed = world_seed;
+	}
+	bool world_changed = !deltas.empty();
+	std::unique_ptr< ReplayRecorder > recorder;
+	if (!config.record.empty()) {
+		recorder.reset(new ReplayRecorder(config.record, seed, animals, config.tick_rate));
+	}
+
 	//------------  initialization ------------
 
+	PROFILE_THREAD_NAME("main");
+
+	//worker threads for asset decoding and simulation:
+	JobSystem jobs(config.workers);
+	startup.mark("job system");
+
+	//------------ sprite info ------------
+
+	//sprite textures are loaded when a screen needs them, and kept within a budget (see texture_cache.hpp):
+	TextureCache textures(jobs, config.texture_budget);
+
+	struct SpriteInfo {
+		glm::vec2 min_uv = glm::vec2(0.0f);
+		glm::vec2 max_uv = glm::vec2(1.0f);
+		glm::vec2 rad = glm::vec2(0.5f);
+		uint32_t texture = TextureCache::None;
+	};
+
+	auto load_sprite = [&textures](std::string const &name) -> SpriteInfo {
+		SpriteInfo info;
+		//TODO: look up sprite name in table of sprite infos
+		//(for now every sprite is a whole image; stumps reuse the tree's)
+		info.texture = textures.add((name == "stump" ? std::string("tree") : name) + ".png");
+		return info;
+	};
+
+	struct {
+		SpriteInfo background;
+		SpriteInfo player;
+		SpriteInfo tree;
+		SpriteInfo stump;
+		SpriteInfo kinds[4]; //indexed by EntityKind
+	} sprites;
+	sprites.background = load_sprite("elements");
+	sprites.background.rad = glm::vec2(20.0f);
+	sprites.player = load_sprite("player");
+	sprites.tree = load_sprite("tree");
+	sprites.stump = load_sprite("stump");
+	sprites.kinds[uint32_t(EntityKind::Wolf)] = load_sprite("wolf");
+	sprites.kinds[uint32_t(EntityKind::Leopard)] = load_sprite("leopard");
+	sprites.kinds[uint32_t(EntityKind::Lion)] = load_sprite("lion");
+	sprites.kinds[uint32_t(EntityKind::Wizard)] = load_sprite("wizard");
+
+	//the world (made this early so its first chunk's textures can start decoding):
+	GameState state(seed, animals, std::move(deltas));
+	if (!config.load.empty()) {
+		//(the snapshot has its own deltas, and they have to be of the same world as any in the world file)
+		if (!load_snapshot(config.load, &state)) return 1;
+		if (world_changed && state.seed != seed) {
+			std::cerr << "Snapshot '" << config.load << "' isn't of the world saved in '" << config.world << "'." << std::endl;
+			return 1;
+		}
+	}
+	//(chunks the player is heading for are generated ahead, on the streaming thread)
+	ScreenStreamer streamer(state);
+	state.streamer = &streamer;
+	//(changes are appended to the world save on its own thread)
+	std::unique_ptr< WorldSaver > saver;
+	if (!config.world.empty()) {
+		saver.reset(new WorldSaver(config.world, state));
+		state.saver = saver.get();
+	}
+	//(snapshots are written out on the autosave thread)
+	std::unique_ptr< Autosaver > autosaver;
+	if (!config.autosave.empty()) {
+		autosaver.reset(new Autosaver(config.autosave, uint64_t(config.autosave_seconds * config.tick_rate)));
+	}
+	//(recent ticks, for stepping back through)
+	std::unique_ptr< RewindBuffer > rewind;
+	if (config.rewind_seconds > 0.0f) {
+		rewind.reset(new RewindBuffer(uint64_t(config.rewind_seconds * config.tick_rate), size_t(config.rewind_budget)));
+	}
+	startup.mark("game state init");
+
+	//textures a chunk draws with (background, player, trees, and each kind of animal on it), at most MaxScreenTextures:
+	static constexpr uint32_t MaxScreenTextures = 8;
+	auto screen_textures = [&sprites, &state](ChunkCoord const &chunk, uint32_t *ids) -> uint32_t {
+		Screen const *at = state.find(chunk);
+		uint32_t count = 0;
+		ids[count++] = sprites.background.texture;
+		ids[count++] = sprites.player.texture;
+		if (!at || at->trees.size()) {
+			ids[count++] = sprites.tree.texture;
+			ids[count++] = sprites.stump.texture;
+		}
+		uint32_t kinds = 0; //bit per EntityKind present
+		if (!at) {
+			//(not loaded; it will have every kind of animal, and maybe the wizard)
+			kinds = (1u << uint32_t(EntityKind::Wolf)) | (1u << uint32_t(EntityKind::Leopard)) | (1u << uint32_t(EntityKind::Lion));
+			if (chunk == state.wizard_chunk) kinds |= 1u << uint32_t(EntityKind::Wizard);
+		} else {
+			Entities const &e = at->entities;
+			for (uint32_t i = 0; i < e.size() && kinds != 0xf; ++i) {
+				kinds |= 1u << uint32_t(e.kind[i]);
+			}
+		}
+		for (uint32_t k = 0; k < 4; ++k) {
+			if (kinds & (1u << k)) ids[count++] = sprites.kinds[k].texture;
+		}
+		return count;
+	};
+
+	//start decoding the first screen's textures now, so it overlaps window and context creation:
+	uint32_t first_textures[MaxScreenTextures];
+	uint32_t first_texture_count = screen_textures(state.screens[state.screen].coord, first_textures);
+	for (uint32_t i = 0; i < first_texture_count; ++i) {
+		textures.request(first_textures[i]);
+	}
+
 	//Initialize SDL library:
 	SDL_Init(SDL_INIT_VIDEO);
+	startup.mark("SDL_Init");
 
 	//Ask for an OpenGL context version 3.3, core profile, enable debug:
 	SDL_GL_ResetAttributes();
@@ -50,6 +265,7 @@ int main(int argc, char **argv) {
 		std::cerr << "Error creating SDL window: " << SDL_GetError() << std::endl;
 		return 1;
 	}
+	startup.mark("SDL_CreateWindow");
 
 	//Create OpenGL context:
 	SDL_GLContext context = SDL_GL_CreateContext(window);
@@ -67,6 +283,7 @@ int main(int argc, char **argv) {
 		return 1;
 	}
 	#endif
+	startup.mark("SDL_GL_CreateContext");
 
 	//Set VSYNC + Late Swap (prevents crazy FPS):
 	if (SDL_GL_SetSwapInterval(-1) != 0) {
@@ -78,68 +295,15 @@ int main(int argc, char **argv) {
 
 	//Hide mouse cursor (note: showing can be useful for debugging):
 	SDL_ShowCursor(SDL_DISABLE);
+	startup.mark("vsync / cursor setup");
 
 	//------------ opengl objects / game assets ------------
 
-	//texture:
-	GLuint tex = 0;
-	glm::uvec2 tex_size = glm::uvec2(0,0);
-	glm::uvec2 wolf_size = glm::uvec2(0,0);
-
-	{ //load texture 'tex':
-		std::vector< uint32_t > data;
-		//load png files
-		if (!load_png("elements.png", &tex_size.x, &tex_size.y, &data, LowerLeftOrigin)) {
-			std::cerr << "Failed to load elements texture." << std::endl;
-			exit(1);
-		}
-		if (!load_png("wolf.png", &tex_size.x, &tex_size.y, &data, LowerLeftOrigin)) {
-			std::cerr << "Failed to load texture." << std::endl;
-			exit(1);
+	{ //finish loading the first screen's textures (see above):
+		for (uint32_t i = 0; i < first_texture_count; ++i) {
+			if (!textures.wait(first_textures[i])) exit(1);
 		}
-		if (!load_png("leopard.png", &tex_size.x, &tex_size.y, &data, LowerLeftOrigin)) {
-			std::cerr << "Failed to load leopard texture." << std::endl;
-			exit(1);
-		}
-		if (!load_png("lion.png", &tex_size.x, &tex_size.y, &data, LowerLeftOrigin)) {
-			std::cerr << "Failed to load lion texture." << std::endl;
-			exit(1);
-		}		
-		if (!load_png("player.png", &tex_size.x, &tex_size.y, &data, LowerLeftOrigin)) {
-			std::cerr << "Failed to load player texture." << std::endl;
-			exit(1);
-		}
-		if (!load_png("meat.png", &tex_size.x, &tex_size.y, &data, LowerLeftOrigin)) {
-			std::cerr << "Failed to load meat texture." << std::endl;
-			exit(1);
-		}
-		if (!load_png("tree.png", &tex_size.x, &tex_size.y, &data, LowerLeftOrigin)) {
-			std::cerr << "Failed to load tree texture." << std::endl;
-			exit(1);
-		}
-		if (!load_png("wizard.png", &tex_size.x, &tex_size.y, &data, LowerLeftOrigin)) {
-			std::cerr << "Failed to load wizard texture." << std::endl;
-			exit(1);
-		}
-		
-		//create a texture object:
-		glGenTextures(1, &tex);
-		//bind texture object to GL_TEXTURE_2D:
-		glBindTexture(GL_TEXTURE_2D, tex);
-		//upload texture data from data:
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, tex_size.x, tex_size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, &data[0]);
-		/*glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, tex_size.x, tex_size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, &data[0]);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, tex_size.x, tex_size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, &data[0]);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, tex_size.x, tex_size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, &data[0]);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, tex_size.x, tex_size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, &data[0]);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, tex_size.x, tex_size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, &data[0]);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, tex_size.x, tex_size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, &data[0]);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, tex_size.x, tex_size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, &data[0]);*/
-		//set texture sampling parameters:
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		startup.mark("load_png + texture upload (first screen)");
 	}
 
 	//shader program:
@@ -149,8 +313,8 @@ int main(int argc, char **argv) {
 	GLuint program_Color = 0;
 	GLuint program_mvp = 0;
 	GLuint program_tex = 0;
-	{ //compile shader program:
-		GLuint vertex_shader = compile_shader(GL_VERTEX_SHADER,
+	{ //compile shader program (or load it from the program cache):
+		std::string vertex_source =
 			"#version 330\n"
 			"uniform mat4 mvp;\n"
 			"in vec4 Position;\n"
@@ -163,9 +327,9 @@ int main(int argc, char **argv) {
 			"	color = Color;\n"
 			"	texCoord = TexCoord;\n"
 			"}\n"
-		);
+		;
 
-		GLuint fragment_shader = compile_shader(GL_FRAGMENT_SHADER,
+		std::string fragment_source =
 			"#version 330\n"
 			"uniform sampler2D tex;\n"
 			"in vec4 color;\n"
@@ -174,9 +338,27 @@ int main(int argc, char **argv) {
 			"void main() {\n"
 			"	fragColor = texture(tex, texCoord) * color;\n"
 			"}\n"
-		);
+		;
+
+		ProgramCache program_cache;
+		program = program_cache.load(vertex_source, fragment_source);
+		startup.mark("program cache lookup");
+
+		if (!program) {
+			auto before = std::chrono::steady_clock::now();
+
+			GLuint vertex_shader = compile_shader(GL_VERTEX_SHADER, vertex_source);
+			startup.mark("compile_shader (vertex)");
+
+			GLuint fragment_shader = compile_shader(GL_FRAGMENT_SHADER, fragment_source);
+			startup.mark("compile_shader (fragment)");
 
-		program = link_program(fragment_shader, vertex_shader);
+			program = link_program(fragment_shader, vertex_shader, &program_cache);
+			startup.mark("link_program");
+
+			float build_seconds = std::chrono::duration< float >(std::chrono::steady_clock::now() - before).count();
+			program_cache.store(program, vertex_source, fragment_source, build_seconds);
+		}
 
 		//look up attribute locations:
 		program_Position = glGetAttribLocation(program, "Position");
@@ -220,141 +402,16 @@ int main(int argc, char **argv) {
 		glEnableVertexAttribArray(program_Position);
 		glEnableVertexAttribArray(program_TexCoord);
 		glEnableVertexAttribArray(program_Color);
+		startup.mark("buffer / VAO setup");
 	}
 
-	//------------ sprite info ------------
-	struct SpriteInfo {
-		glm::vec2 min_uv = glm::vec2(0.0f);
-		glm::vec2 max_uv = glm::vec2(1.0f);
-		glm::vec2 rad = glm::vec2(0.5f);
-	};
-
-	auto load_sprite = [](std::string const &name) -> SpriteInfo {
-		SpriteInfo info;
-		//TODO: look up sprite name in table of sprite infos
-		return info;
-	};
-
-	auto random_float = [](float a, float b) {
-		float random = ((float) rand()) / (float) RAND_MAX;
-		float r = random * (b - a);
-		return (a + r);
-	};
-
-	auto set_random_pos = [](glm::vec2 *objpos) {
-		float random_x = ((float) rand()) / (float) RAND_MAX;
-		float random_y = ((float) rand()) / (float) RAND_MAX;
-		float r_x = (random_x * (2.0f) - 1.0f);
-		float r_y = (random_y * (2.0f) - 1.0f);
-		objpos->x = r_x;
-		objpos->y = r_y;
-		return objpos;
-	};
-
-
 	//------------ game state ------------
 
-	//Initialization
-
 	//Mouse
 	glm::vec2 mouse = glm::vec2(0.0f, 0.0f); //mouse position in [-1,1]x[-1,1] coordinates
 
-	//set positions of all living things
-	glm::vec2 playerpos = glm::vec2(0.0f, 0.0f);
-	glm::vec2 wolfpos = glm::vec2(random_float(-1.0f, 1.0f), random_float(-1.0f, 1.0f));
-	glm::vec2 lionpos = glm::vec2(random_float(-1.0f, 1.0f), random_float(-1.0f, 1.0f));
-	glm::vec2 leopos = glm::vec2(random_float(-1.0f, 1.0f), random_float(-1.0f, 1.0f));
-	glm::vec2 wizardpos = glm::vec2(1.6f, 0.2f); //off screen, but exists initially
-
-	//place treeses
-	struct tree {
-		glm::vec2 position;
-		float height;
-		tree(glm::vec2 position, float height) : position(position), height(height) {}
-	};
-
-	std::vector<tree> treeScreen1;
-	std::vector<tree> treeScreen2;
-	std::vector<tree> treeScreen3;
-
-	//place trees randomly throughout world
-	for (int i = 0; i < 8; i++) {
-		treeScreen1.emplace_back(glm::vec2(random_float(-1.0f, 1.0f), random_float(-1.0f, 1.0f)), 1.0f);
-		treeScreen2.emplace_back(glm::vec2(random_float(-1.0f, 1.0f), random_float(-1.0f, 1.0f)), 1.0f);
-		treeScreen3.emplace_back(glm::vec2(random_float(-1.0f, 1.0f), random_float(-1.0f, 1.0f)), 1.0f);
-	}
-
-	//player bound variables
-	float playerHealth = 1.0f;
-	float playerTemp = 1.0f;
-	//damage applied every frame from climate
-	float healthDecay = 0.00037f;
-	float tempDecay = 0.000037f;
-	//inventory
-	int lumber = 0;
-	int meat = 0;
-	//set amounts of trees
-	int numTreesperScreen = 8;
-	//amount of health meat replaces
-	float meatRegen = 0.1f;
-	//replenish 75% of health when wizard is offered meat
-	float wizardRegen = 0.75f;
-
-	//boolean triggers
-	bool wolfCollide = false;
-	bool lionCollide = false;
-	bool leoCollide = false;
-	bool wizardCollide = false;
-	bool treeCollide = false;
-	int treeCollideInstance = -1;
-
-	//set initial speeds of interactable things
-	float playerSpeed = 0.05f;
-	float wolfSpeed = 0.0002f;
-	float lionSpeed = 0.0003f;
-	float leoSpeed = 0.0005f;
-	float treeGrowRate = 0.0002f;
-
-	//set amounts of meat animals drop
-	int wolfMeat = 1;
-	int leopardMeat = 2;
-	int lionMeat = 3;
-
-	//set amount of damage each animal causes per frame on contact
-	float wolfDamage = 0.0002f;
-	float leoDamage = 0.0003f;
-	float lionDamage = 0.0005f;
-
-	//animal livelyhood states
-	bool wolfIsAlive = true;
-	bool leoIsAlive = true;
-	bool lionIsAlive = true;
-
-	//set aggravated animal radius boxes
-	float boxSizeMultiplier = 1000.0f;
-	float wolfBox = wolfSpeed * boxSizeMultiplier;
-	float lionBox = lionSpeed * boxSizeMultiplier;
-	float leoBox = leoSpeed * boxSizeMultiplier;
-	float wizardBox = 0.1f;
-	float treeBox = 0.05f;
-
-	//set timer to respawn
-	float wolfDeadTime = 0.0f;
-	float leoDeadTime = 0.0f;
-	float lionDeadTime = 0.0f;
-
-	//set respawn times
-	float wolfSpawnTime = 30.0f; //wolf spawns every 30 seconds
-	float leoSpawnTime = 60.0f; //leopard spawns every minute
-	float lionSpawnTime = 120.0f; //lion spawns every other minutes
-	float treeSpawnTime = 120.0f; //2 minutes to respawn tree
-
-	//timer tracking total time of current game session
-	float totalTime = 0.0f;
-
-	//floats represent bool of that screens appearance
-	//begin on middle screen
-	glm::vec3 screen = glm::vec3(0.0f, 1.0f, 0.0f);
+	//actions taken since the last tick:
+	Inputs pending;
 
 	struct {
 		glm::vec2 at = glm::vec2(0.0f, 0.0f);
@@ -365,173 +422,96 @@ int main(int argc, char **argv) {
 
 	//------------ game loop ------------
 
+	//per-frame temporaries (vertex lists, ...) live here; reset at the top of each frame:
+	FrameArena frame_arena(64 * 1024, MemTag::Vertices);
+	//after the first few frames (which load sprites and size the arena), frames shouldn't touch the heap:
+	uint32_t const WarmupFrames = 120;
+	uint64_t frames = 0;
+	uint64_t steady_heap_allocations = 0;
+	//memory overlay (F3), shown in the window title since there is no text drawing:
+	bool show_memory = false;
+
 	bool should_quit = false;
 	while (true) {
+		PROFILE_ZONE("frame");
+		frame_arena.reset();
+		uint64_t heap_before = heap_allocations();
 		static SDL_Event evt;
-		while (SDL_PollEvent(&evt) == 1) {
-			//handle input:
-			if (evt.type == SDL_MOUSEMOTION) {
-				mouse.x = (evt.motion.x + 0.5f) / float(config.size.x) * 2.0f - 1.0f;
-				mouse.y = (evt.motion.y + 0.5f) / float(config.size.y) *-2.0f + 1.0f;
-			} else if (evt.type == SDL_MOUSEBUTTONDOWN) {
-			} else if (evt.type == SDL_KEYDOWN) {
-				if (evt.key.keysym.sym == SDLK_ESCAPE)
-					should_quit = true;
+		{ //handle input:
+			PROFILE_ZONE("handle input");
+			while (SDL_PollEvent(&evt) == 1) {
+				if (evt.type == SDL_MOUSEMOTION) {
+					mouse.x = (evt.motion.x + 0.5f) / float(config.size.x) * 2.0f - 1.0f;
+					mouse.y = (evt.motion.y + 0.5f) / float(config.size.y) *-2.0f + 1.0f;
+				} else if (evt.type == SDL_MOUSEBUTTONDOWN) {
+				} else if (evt.type == SDL_KEYDOWN) {
+					if (evt.key.keysym.sym == SDLK_ESCAPE)
+						should_quit = true;
+
+					//dump profiler zones (debug builds only)
+					else if (evt.key.keysym.sym == SDLK_F9) {
+						if (PROFILE_WRITE_TRACE("profile.json"))
+							std::cout << "Wrote profiler trace to 'profile.json'." << std::endl;
+					}
 
-				//for walking
-				else if (evt.key.keysym.sym == SDLK_w) {
-					if (playerpos.y <= 1.0f)
-						playerpos.y += playerSpeed;
-				}
-				else if (evt.key.keysym.sym == SDLK_s) {
-					//check for lower boundaries
-					if (playerpos.y >= -1.0f)
-						playerpos.y -= playerSpeed;
-				}
-				else if (evt.key.keysym.sym == SDLK_d) {
-					//check for right boundaries
-					if (screen.z != 1.0f) {
-						//currently not on leftmost screen
-						if (playerpos.x >= 1.0f) {
-							//place player into next screen
-							playerpos.x = -std::abs(playerpos.x);
-							if (screen.x == 1.0f) {
-								screen.x = 0.0f;
-								screen.y = 1.0f;
-								//set random positions to animals since screens are separated
-								if (wolfIsAlive) set_random_pos(&wolfpos);
-								if (leoIsAlive) set_random_pos(&leopos);
-								if (lionIsAlive) set_random_pos(&lionpos);
-								wizardpos -= glm::vec2 (1.0f, 0.0f);
-							}
-							else if (screen.y == 1.0f) {
-								screen.y = 0.0f;
-								screen.z = 1.0f;
-								if (wolfIsAlive) set_random_pos(&wolfpos);
-								if (leoIsAlive) set_random_pos(&leopos);
-								if (lionIsAlive) set_random_pos(&lionpos);
-								wizardpos -= glm::vec2 (1.0f, 0.0f);
-							}
-						}
-						else
-							playerpos.x += playerSpeed;
+					//toggle the memory overlay
+					else if (evt.key.keysym.sym == SDLK_F3) {
+						show_memory = !show_memory;
+						if (!show_memory) SDL_SetWindowTitle(window, config.title.c_str());
 					}
-					else {
-						if (playerpos.x < 1.0f)
-							playerpos.x += playerSpeed;
+
+					//quicksave / quickload (between ticks, so the snapshot is a whole tick's state)
+					else if (evt.key.keysym.sym == SDLK_F5) {
+						auto before = std::chrono::high_resolution_clock::now();
+						if (save_snapshot(state, config.quicksave)) {
+							std::cout << "Saved '" << config.quicksave << "' in " << std::chrono::duration< double >(std::chrono::high_resolution_clock::now() - before).count() * 1000.0 << " ms." << std::endl;
+						}
 					}
-				}
-				else if (evt.key.keysym.sym == SDLK_a) {
-					//check for left boundaries
-					if (screen.x != 1.0f) {
-						//currently not on leftmost screen
-						if (playerpos.x <= -1.0f) {
-							//place player into next screen
-							playerpos.x = std::abs(playerpos.x);
-							if (screen.y == 1.0f) {
-								screen.y = 0.0f;
-								screen.x = 1.0f;
-								if (wolfIsAlive) set_random_pos(&wolfpos);
-								if (leoIsAlive) set_random_pos(&leopos);
-								if (lionIsAlive) set_random_pos(&lionpos);
-								wizardpos += glm::vec2 (1.0f, 0.0f);
-							}
-							else if (screen.z == 1.0f) {
-								screen.z = 0.0f;
-								screen.y = 1.0f;
-								if (wolfIsAlive) set_random_pos(&wolfpos);
-								if (leoIsAlive) set_random_pos(&leopos);
-								if (lionIsAlive) set_random_pos(&lionpos);
-								wizardpos += glm::vec2(1.0f, 0.0f);
+					else if (evt.key.keysym.sym == SDLK_F8) {
+						if (replaying || recorder) {
+							std::cout << "Can't quickload while recording or replaying (replays start from a new game)." << std::endl;
+						} else {
+							auto before = std::chrono::high_resolution_clock::now();
+							if (load_snapshot(config.quicksave, &state)) {
+								pending.actions.clear();
+								if (rewind) rewind->clear();
+								std::cout << "Loaded '" << config.quicksave << "' (tick " << state.ticks << ") in " << std::chrono::duration< double >(std::chrono::high_resolution_clock::now() - before).count() * 1000.0 << " ms." << std::endl;
 							}
 						}
-						else
-							playerpos.x -= playerSpeed;
-					}
-					else {
-						if (playerpos.x > -1.0f)
-							playerpos.x -= playerSpeed;
 					}
-				}
 
-				//for interaction
-				else if (evt.key.keysym.sym == SDLK_x) {
-					//chop down tree or attack
-					//animals
-					if (wolfCollide) {
-						wolfCollide = false;
-						wolfSpeed = 0.0f;
-						wolfpos = glm::vec2(10.0f, 10.0f);
-					}
-					else if (leoCollide) {
-						leoCollide = false;
-						leoSpeed = 0.0f;
-						leopos = glm::vec2(10.0f, 10.0f);
-					}
-					else if (lionCollide) {
-						lionCollide = false;
-						lionSpeed = 0.0f;
-						lionpos = glm::vec2(10.0f, 10.0f);
-					}
-					//tree
-					if ((treeCollide) && (treeCollideInstance >= 0)) {
-						if (screen.x == 1.0) {
-							treeScreen1[treeCollideInstance].height = 0.0f;
-						}
-						else if (screen.y == 1.0) {
-							treeScreen2[treeCollideInstance].height = 0.0f;
+					//step back a second (or as far as is kept); holding it down keeps going
+					else if (evt.key.keysym.sym == SDLK_BACKSPACE && rewind) {
+						if (recorder) {
+							std::cout << "Can't rewind while recording (recordings only go forward)." << std::endl;
+						} else if (!rewind->empty()) {
+							uint64_t back = std::max< uint64_t >(1, uint64_t(config.tick_rate));
+							uint64_t tick = (rewind->newest() - rewind->oldest() > back ? rewind->newest() - back : rewind->oldest());
+							auto before = std::chrono::high_resolution_clock::now();
+							if (rewind->rewind(tick, &state)) {
+								pending.actions.clear();
+								std::cout << "Rewound to tick " << state.ticks << " in " << std::chrono::duration< double >(std::chrono::high_resolution_clock::now() - before).count() * 1000.0 << " ms." << std::endl;
+							}
 						}
-						else
-							treeScreen3[treeCollideInstance].height = 0.0f;
-
 					}
 
-
-				}
-				else if (evt.key.keysym.sym == SDLK_f) {
-					if (lumber > 0)
-						lumber --;
-				}
-				else if (evt.key.keysym.sym == SDLK_e) {
-					if (meat > 0) {
-						meat --;
-						if ((playerHealth + meatRegen) > 1.0f)
-							playerHealth = 1.0f;
-						else
-							playerHealth += meatRegen;
-					}
+					//for walking
+					else if (evt.key.keysym.sym == SDLK_w) pending.actions.emplace_back(Action::Up);
+					else if (evt.key.keysym.sym == SDLK_s) pending.actions.emplace_back(Action::Down);
+					else if (evt.key.keysym.sym == SDLK_a) pending.actions.emplace_back(Action::Left);
+					else if (evt.key.keysym.sym == SDLK_d) pending.actions.emplace_back(Action::Right);
+
+					//for interaction
+					else if (evt.key.keysym.sym == SDLK_x) pending.actions.emplace_back(Action::Attack);
+					else if (evt.key.keysym.sym == SDLK_f) pending.actions.emplace_back(Action::DropLumber);
+					else if (evt.key.keysym.sym == SDLK_e) pending.actions.emplace_back(Action::EatMeat);
+					else if (evt.key.keysym.sym == SDLK_c) pending.actions.emplace_back(Action::Interact);
 				}
-				else if (evt.key.keysym.sym == SDLK_c) {
-					if (wolfCollide)
-						meat += wolfMeat;
-					else if (leoCollide)
-						meat += leopardMeat;
-					else if (lionCollide)
-						meat += lionMeat;
-					//Player interacting with wizard
-					else if (wizardCollide) {
-
-						if (meat > 0) {
-							meat --;
-							if ((playerHealth + wizardRegen) > 1.0f)
-								playerHealth = 1.0f;
-							else
-								playerHealth += wizardRegen;
-						}
-					    if (lumber > 0) {
-					    	lumber --;
-					    	if ((playerHealth + wizardRegen) > 1.0f)
-					    		playerHealth = 1.0f;
-					    	else
-					    		playerHealth += wizardRegen;
-					    }
-					}
+				else if (evt.type == SDL_QUIT) {
+					should_quit = true;
+					break;
 				}
 			}
-			else if (evt.type == SDL_QUIT) {
-				should_quit = true;
-				break;
-			}
 		}
 		if (should_quit) break;
 
@@ -539,10 +519,34 @@ int main(int argc, char **argv) {
 		static auto previous_time = current_time;
 		float elapsed = std::chrono::duration< float >(current_time - previous_time).count();
 		previous_time = current_time;
-		totalTime += elapsed;
+
+		//fraction of a tick that has elapsed since the latest tick (for interpolation):
+		float alpha = 0.0f;
 
 		{ //update game state:
-			(void)elapsed;
+			PROFILE_ZONE("update game state");
+
+			float const tick_length = 1.0f / config.tick_rate;
+
+			//run however many fixed-length ticks fit into the time since the last frame
+			// (capped, so a long stall doesn't leave us permanently catching up):
+			static float accumulator = 0.0f;
+			accumulator += std::min(elapsed, 0.25f);
+			while (accumulator >= tick_length) {
+				accumulator -= tick_length;
+				if (replaying) replay.inputs_for(state.ticks, &pending);
+				if (recorder) recorder->record(state.ticks, pending);
+				tick(state, pending, tick_length, &jobs);
+				pending.actions.clear();
+				if (autosaver) autosaver->update(state);
+				if (rewind) rewind->record(state);
+				if (replaying && replay.done(state.ticks)) {
+					std::cout << "Replay finished after " << state.ticks << " ticks; state checksum " << std::hex << state.checksum() << std::dec << "." << std::endl;
+					should_quit = true;
+					break;
+				}
+			}
+			alpha = accumulator / tick_length;
 		}
 
 		//draw output:
@@ -553,19 +557,40 @@ int main(int argc, char **argv) {
 
 
 		{ //draw game state:
-			std::vector< Vertex > verts;
+			PROFILE_ZONE("draw game state");
+			Screen const &here = state.screens[state.screen];
+
+			//stream in the next screen's textures while the player walks towards it
+			// (the same prediction the simulation uses to generate the screen itself ahead of time):
+			ChunkCoord next = predicted_chunk(state);
+			if (next != here.coord) {
+				uint32_t ids[MaxScreenTextures];
+				uint32_t count = screen_textures(next, ids);
+				for (uint32_t i = 0; i < count; ++i) {
+					textures.request(ids[i]);
+				}
+			}
 
-			//helper: add rectangle to verts:
-			auto rect = [&verts](glm::vec2 const &at, glm::vec2 const &rad, glm::u8vec4 const &tint) {
-				verts.emplace_back(at + glm::vec2(-rad.x,-rad.y), glm::vec2(0.0f, 0.0f), tint);
-				verts.emplace_back(verts.back());
-				verts.emplace_back(at + glm::vec2(-rad.x, rad.y), glm::vec2(0.0f, 1.0f), tint);
-				verts.emplace_back(at + glm::vec2( rad.x,-rad.y), glm::vec2(1.0f, 0.0f), tint);
-				verts.emplace_back(at + glm::vec2( rad.x, rad.y), glm::vec2(1.0f, 1.0f), tint);
-				verts.emplace_back(verts.back());
+			//(background + player + entities + trees, six vertices each)
+			FrameVector< Vertex > verts{FrameAllocator< Vertex >(frame_arena)};
+			verts.reserve(6 * (2 + here.entities.size() + here.trees.size()));
+			//runs of vertices drawn with the same texture:
+			struct Batch {
+				GLuint texture;
+				uint32_t first;
+				uint32_t count;
 			};
+			FrameVector< Batch > batches{FrameAllocator< Batch >(frame_arena)};
+			batches.reserve(2 * MaxScreenTextures);
+
+			auto draw_sprite = [&verts, &batches, &textures](SpriteInfo const &sprite, glm::vec2 const &at) {
+				GLuint texture = textures.use(sprite.texture);
+				if (texture == 0) return; //(not resident yet; it has been requested)
+				if (batches.empty() || batches.back().texture != texture) {
+					batches.push_back(Batch{texture, uint32_t(verts.size()), 0});
+				}
+				batches.back().count += 6;
 
-			auto draw_sprite = [&verts](SpriteInfo const &sprite, glm::vec2 const &at) {
 				glm::vec2 min_uv = sprite.min_uv;
 				glm::vec2 max_uv = sprite.max_uv;
 				glm::vec2 rad = sprite.rad;
@@ -579,147 +604,121 @@ int main(int argc, char **argv) {
 				verts.emplace_back(verts.back());
 			};
 
-			//if the player is close enough to an animal, the animal will run towards player
-			auto collision = [&playerpos](glm::vec2 *spritepos, float spriteRad, float spriteSpeed, bool *collision) {
-				if ((playerpos.x > (spritepos->x - spriteRad)) && 
-					(playerpos.x < (spritepos->x + spriteRad)) &&
-					(playerpos.y > (spritepos->y - spriteRad)) &&
-					(playerpos.y < (spritepos->y + spriteRad))) {
-					//find vector to player pos, update position
-					//spritepos->y = spritepos->y + spriteSpeed;
-					if ((playerpos.x - spritepos->x) < 0)
-						spritepos->x -= spriteSpeed;
-					else if ((playerpos.x - spritepos->x) > 0)
-						spritepos->x += spriteSpeed;
-					if ((playerpos.y - spritepos->y) < 0)
-						spritepos->y -= spriteSpeed;
-					else if ((playerpos.y - spritepos->y) > 0)
-						spritepos->y += spriteSpeed;
-					*collision = true;
-				}
-				else
-					collision = false;
-			};
-
-			//if animal reaches player, cause damage every frame
-			auto direct_collision = [&playerpos, &playerHealth](glm::vec2 *spritepos, float spriteRad, float spriteDamage) {
-				if ((playerpos.x > (spritepos->x - spriteRad)) && 
-					(playerpos.x < (spritepos->x + spriteRad)) &&
-					(playerpos.y > (spritepos->y - spriteRad)) &&
-					(playerpos.y < (spritepos->y + spriteRad))) {
-					playerHealth -= spriteDamage;
-				}
+			//position between the last two ticks:
+			auto lerp = [alpha](glm::vec2 const &before, glm::vec2 const &after) {
+				return before + (after - before) * alpha;
 			};
 
-			//Constant decay on player
-			playerHealth -= healthDecay;
-			playerTemp -= tempDecay;
-
-			if (playerHealth <= 0.0f)
-				playerSpeed = 0.0f; //can't move if you're dead
-
-			//respawn animals if respawn timer is up
-			if (!wolfIsAlive && ((totalTime - wolfDeadTime) > wolfSpawnTime)) {
-				wolfIsAlive = true;;
-				wolfSpeed  = 0.0002f * (totalTime / 100.0f);
-				wolfpos = glm::vec2(random_float(-1.0f, 1.0f), random_float(-1.0f, 1.0f));
-				//each time an animal respawns, collision detection boxes on all animals will increase
-				boxSizeMultiplier *= 1.5f;
-			}
-			if (!leoIsAlive && ((totalTime - leoDeadTime) > leoSpawnTime)) {
-				leoIsAlive = true;
-				leoSpeed = 0.0003f * (totalTime / 100.0f);
-				leopos = glm::vec2(random_float(-1.0f, 1.0f), random_float(-1.0f, 1.0f));
-				boxSizeMultiplier *= 1.5f;
-			}
-			if (!lionIsAlive && ((totalTime - lionDeadTime) > lionSpawnTime)) {
-				lionIsAlive = true;
-				lionSpeed = 0.0005f * (totalTime / 100.0f);
-				lionpos = glm::vec2(random_float(-1.0f, 1.0f), random_float(-1.0f, 1.0f));
-				boxSizeMultiplier *= 1.5f;
-			}
-
-			//draw appropriate background
-			rect(glm::vec2(-10.0f, 10.0f), glm::vec2(20.0f), glm::u8vec4(0xff, 0xff, 0xff, 0xff));
-
-			//Draw a sprite "player" at position (5.0, 2.0):
-			static SpriteInfo player = load_sprite("player");
-			draw_sprite(player, playerpos * camera.radius + camera.at);
-			static SpriteInfo wolf = load_sprite("wolf");
-			draw_sprite(wolf, wolfpos * camera.radius + camera.at);
-			static SpriteInfo leopard = load_sprite("leopard");
-			draw_sprite(leopard, leopos * camera.radius + camera.at);
-			static SpriteInfo lion = load_sprite("lion");
-			draw_sprite(lion, lionpos * camera.radius + camera.at);
-			static SpriteInfo wizard = load_sprite("wizard");
-			draw_sprite(wizard, wizardpos * camera.radius + camera.at);
-			static SpriteInfo tree = load_sprite("tree");
-			static SpriteInfo stump = load_sprite("stump");
-			if (screen.x == 1.0f) {
-				for (int i = 0; i < numTreesperScreen; i ++) {
-					if (treeScreen1[i].height < 1.0f)  {
-						draw_sprite(stump, treeScreen1[i].position * camera.radius + camera.at);
-						if ((treeScreen1[i].height + treeGrowRate) > 1.0f)
-							treeScreen1[i].height = 1.0f;
-						else
-							treeScreen1[i].height += treeGrowRate;
-					}
-					else {
-						draw_sprite(tree, treeScreen1[i].position * camera.radius + camera.at);
-						collision(&(treeScreen1[i].position * camera.radius + camera.at), treeBox, 0.0f, &treeCollide);
+			{ //generate vertices:
+				PROFILE_ZONE("vertex generation");
+				//draw appropriate background
+				draw_sprite(sprites.background, glm::vec2(-10.0f, 10.0f));
+
+				draw_sprite(sprites.player, lerp(state.previous_playerpos, state.playerpos) * camera.radius + camera.at);
+				//(one kind at a time, so each kind's sprites share a batch)
+				Entities const &e = here.entities;
+				for (uint32_t k = 0; k < 4; ++k) {
+					for (uint32_t i = 0; i < e.size(); ++i) {
+						if (uint32_t(e.kind[i]) != k) continue;
+						glm::vec2 before(e.prev_x[i], e.prev_y[i]);
+						glm::vec2 after(e.x[i], e.y[i]);
+						draw_sprite(sprites.kinds[k], lerp(before, after) * camera.radius + camera.at);
 					}
 				}
-			}
-			else if (screen.y == 1.0f) {
-				for (int i = 0; i < 8; i ++) {
-					if (treeScreen2[i].height == 0.0f)
-						draw_sprite(stump, treeScreen2[i].position * camera.radius + camera.at);
-					else
-						draw_sprite(tree, treeScreen2[i].position * camera.radius + camera.at);
+				Trees const &trees = here.trees;
+				for (uint32_t i = 0; i < trees.size(); ++i) {
+					glm::vec2 at(trees.x[i], trees.y[i]);
+					float height = tree_height(trees, i, state.totalTime, state.treeGrowRate * ReferenceTickRate);
+					draw_sprite(height < 1.0f ? sprites.stump : sprites.tree, at * camera.radius + camera.at);
 				}
 			}
-			else if (screen.z == 1.0f) {
-				for (int i = 0; i < 8; i ++) {
-					if (treeScreen3[i].height == 0.0f)
-						draw_sprite(stump, treeScreen3[i].position * camera.radius + camera.at);
-					else
-						draw_sprite(tree, treeScreen3[i].position * camera.radius + camera.at);
+
+			PROFILE_ZONE("gl submit");
+			if (!verts.empty()) {
+				glBindBuffer(GL_ARRAY_BUFFER, buffer);
+				glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * verts.size(), &verts[0], GL_STREAM_DRAW);
+				gl_memory_upload(GLMemKind::Buffer, buffer, sizeof(Vertex) * verts.size());
+
+				glUseProgram(program);
+				glUniform1i(program_tex, 0);
+				glm::vec2 scale = 1.0f / camera.radius;
+				glm::vec2 offset = scale * -camera.at;
+				glm::mat4 mvp = glm::mat4(
+					glm::vec4(scale.x, 0.0f, 0.0f, 0.0f),
+					glm::vec4(0.0f, scale.y, 0.0f, 0.0f),
+					glm::vec4(0.0f, 0.0f, 1.0f, 0.0f),
+					glm::vec4(offset.x, offset.y, 0.0f, 1.0f)
+				);
+				glUniformMatrix4fv(program_mvp, 1, GL_FALSE, glm::value_ptr(mvp));
+
+				glBindVertexArray(vao);
+				for (Batch const &batch : batches) {
+					glBindTexture(GL_TEXTURE_2D, batch.texture);
+					glDrawArrays(GL_TRIANGLE_STRIP, batch.first, batch.count);
 				}
 			}
+		}
 
-			collision(&wolfpos, wolfBox, wolfSpeed, &wolfCollide);
-			collision(&leopos, leoBox, leoSpeed, &leoCollide);
-			collision(&lionpos, lionBox, lionSpeed, &lionCollide);
-			collision(&wizardpos, wizardBox, 0.0f, &wizardCollide);
+		//upload newly decoded textures, evict over budget:
+		textures.update();
 
 
-			glBindBuffer(GL_ARRAY_BUFFER, buffer);
-			glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * verts.size(), &verts[0], GL_STREAM_DRAW);
+		{ PROFILE_ZONE("swap");
+			SDL_GL_SwapWindow(window);
+		}
 
-			glUseProgram(program);
-			glUniform1i(program_tex, 0);
-			glm::vec2 scale = 1.0f / camera.radius;
-			glm::vec2 offset = scale * -camera.at;
-			glm::mat4 mvp = glm::mat4(
-				glm::vec4(scale.x, 0.0f, 0.0f, 0.0f),
-				glm::vec4(0.0f, scale.y, 0.0f, 0.0f),
-				glm::vec4(0.0f, 0.0f, 1.0f, 0.0f),
-				glm::vec4(offset.x, offset.y, 0.0f, 1.0f)
-			);
-			glUniformMatrix4fv(program_mvp, 1, GL_FALSE, glm::value_ptr(mvp));
+		//(refreshed a couple of times a second; memory_overlay doesn't allocate)
+		if (show_memory && frames % 30 == 0) {
+			char line[256];
+			memory_overlay(line, sizeof(line));
+			SDL_SetWindowTitle(window, line);
+		}
 
-			glBindTexture(GL_TEXTURE_2D, tex);
-			glBindVertexArray(vao);
+		frames += 1;
+		if (frames > WarmupFrames) steady_heap_allocations += heap_allocations() - heap_before;
 
-			glDrawArrays(GL_TRIANGLE_STRIP, 0, verts.size());
+		static bool first_frame = true;
+		if (first_frame) {
+			first_frame = false;
+			startup.mark("first frame");
+			startup.print_summary(std::cout);
+			if (config.exit_after_first_frame) break;
 		}
+	}
 
 
-		SDL_GL_SwapWindow(window);
+	//------------  teardown ------------
+
+	if (recorder) {
+		recorder->finish(state.ticks);
+		std::cout << "Recorded " << state.ticks << " ticks to '" << config.record << "'; state checksum " << std::hex << state.checksum() << std::dec << "." << std::endl;
 	}
 
+	//how busy the worker threads were (startup decoding + simulation):
+	jobs.report(std::cout);
 
-	//------------  teardown ------------
+	std::cout << "Frame arena: peak " << frame_arena.peak() << " bytes in a frame (arena holds " << frame_arena.capacity() << "); "
+	          << steady_heap_allocations << " heap allocations in " << (frames > WarmupFrames ? frames - WarmupFrames : 0) << " frames after warm-up." << std::endl;
+
+	//texture residency (bandwidth averaged over the whole session):
+	textures.report(std::cout, jobs.elapsed());
+	textures.release();
+	streamer.report(std::cout);
+	if (saver) {
+		saver->finish(state.totalTime);
+		saver->report(std::cout);
+	}
+	if (autosaver) {
+		autosaver->wait();
+		autosaver->report(std::cout);
+	}
+	if (rewind) rewind->report(std::cout);
+
+	std::cout << "Memory:\n";
+	memory_report(std::cout);
+	if (!config.memory_report.empty() && memory_write_report(config.memory_report)) {
+		std::cout << "Wrote memory report to '" << config.memory_report << "'." << std::endl;
+	}
 
 	SDL_GL_DeleteContext(context);
 	context = 0;
@@ -754,10 +753,11 @@ static GLuint compile_shader(GLenum type, std::string const &source) {
 	return shader;
 }
 
-static GLuint link_program(GLuint fragment_shader, GLuint vertex_shader) {
+static GLuint link_program(GLuint fragment_shader, GLuint vertex_shader, ProgramCache const *cache) {
 	GLuint program = glCreateProgram();
 	glAttachShader(program, vertex_shader);
 	glAttachShader(program, fragment_shader);
+	if (cache) cache->prepare(program);
 	glLinkProgram(program);
 	GLint link_status = GL_FALSE;
 	glGetProgramiv(program, GL_LINK_STATUS, &link_status);
@@ -0,0 +1,222 @@
+#include "memory_stats.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <vector>
+
+//------------ CPU heap ------------
+
+//each block starts with a header saying how big it is and who it was charged to
+// (padded to malloc's alignment, so the caller's pointer is aligned just as malloc's would be):
+struct alignas(std::max_align_t) BlockHeader {
+	std::size_t size;
+	MemTag tag;
+};
+
+struct TagCounters {
+	std::atomic< uint64_t > live{0};
+	std::atomic< uint64_t > peak{0};
+	std::atomic< uint64_t > allocations{0};
+};
+
+static TagCounters tag_counters[size_t(MemTag::Count)];
+static std::atomic< uint64_t > allocations{0};
+static thread_local MemTag current_tag = MemTag::Other;
+
+char const *mem_tag_name(MemTag tag) {
+	switch (tag) {
+		case MemTag::Other: return "other";
+		case MemTag::Assets: return "assets";
+		case MemTag::Vertices: return "vertices";
+		case MemTag::Entities: return "entities";
+		case MemTag::World: return "world";
+		case MemTag::Jobs: return "jobs";
+		case MemTag::Rewind: return "rewind";
+		case MemTag::Count: break;
+	}
+	return "?";
+}
+
+MemTagScope::MemTagScope(MemTag tag) : previous(current_tag) {
+	current_tag = tag;
+}
+
+MemTagScope::~MemTagScope() {
+	current_tag = previous;
+}
+
+static void raise_peak(std::atomic< uint64_t > &peak, uint64_t live) {
+	uint64_t seen = peak.load(std::memory_order_relaxed);
+	while (seen < live && !peak.compare_exchange_weak(seen, live, std::memory_order_relaxed)) {
+	}
+}
+
+MemoryTotals memory_totals(MemTag tag) {
+	TagCounters const &counters = tag_counters[size_t(tag)];
+	MemoryTotals totals;
+	totals.live = counters.live.load(std::memory_order_relaxed);
+	totals.peak = counters.peak.load(std::memory_order_relaxed);
+	totals.allocations = counters.allocations.load(std::memory_order_relaxed);
+	return totals;
+}
+
+uint64_t heap_allocations() {
+	return allocations.load(std::memory_order_relaxed);
+}
+
+void *operator new(std::size_t size) {
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	BlockHeader *header = static_cast< BlockHeader * >(std::malloc(sizeof(BlockHeader) + size));
+	if (!header) throw std::bad_alloc();
+	header->size = size;
+	header->tag = current_tag;
+	TagCounters &counters = tag_counters[size_t(header->tag)];
+	counters.allocations.fetch_add(1, std::memory_order_relaxed);
+	raise_peak(counters.peak, counters.live.fetch_add(size, std::memory_order_relaxed) + size);
+	return header + 1;
+}
+
+void *operator new[](std::size_t size) {
+	return operator new(size);
+}
+
+void operator delete(void *ptr) noexcept {
+	if (!ptr) return;
+	BlockHeader *header = static_cast< BlockHeader * >(ptr) - 1;
+	//(credited to the tag it was charged to, whichever thread or scope frees it)
+	tag_counters[size_t(header->tag)].live.fetch_sub(header->size, std::memory_order_relaxed);
+	std::free(header);
+}
+
+void operator delete[](void *ptr) noexcept {
+	operator delete(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+	operator delete(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t) noexcept {
+	operator delete(ptr);
+}
+
+//------------ GL ------------
+
+struct GLCounters {
+	std::vector< uint64_t > sizes; //bytes held, indexed by object name
+	uint64_t live = 0;
+	uint64_t peak = 0;
+	uint64_t uploads = 0;
+	uint64_t uploaded = 0;
+};
+
+static GLCounters gl_counters[size_t(GLMemKind::Count)];
+
+char const *gl_mem_kind_name(GLMemKind kind) {
+	switch (kind) {
+		case GLMemKind::Texture: return "textures";
+		case GLMemKind::Buffer: return "buffers";
+		case GLMemKind::Count: break;
+	}
+	return "?";
+}
+
+void gl_memory_upload(GLMemKind kind, uint32_t name, uint64_t bytes) {
+	GLCounters &counters = gl_counters[size_t(kind)];
+	if (name >= counters.sizes.size()) counters.sizes.resize(name + 1, 0);
+	counters.live += bytes - counters.sizes[name];
+	counters.sizes[name] = bytes;
+	if (counters.live > counters.peak) counters.peak = counters.live;
+	counters.uploads += 1;
+	counters.uploaded += bytes;
+}
+
+void gl_memory_delete(GLMemKind kind, uint32_t name) {
+	GLCounters &counters = gl_counters[size_t(kind)];
+	if (name >= counters.sizes.size()) return;
+	counters.live -= counters.sizes[name];
+	counters.sizes[name] = 0;
+}
+
+MemoryTotals gl_memory_totals(GLMemKind kind) {
+	GLCounters const &counters = gl_counters[size_t(kind)];
+	MemoryTotals totals;
+	totals.live = counters.live;
+	totals.peak = counters.peak;
+	totals.allocations = counters.uploads;
+	return totals;
+}
+
+uint64_t gl_memory_uploaded(GLMemKind kind) {
+	return gl_counters[size_t(kind)].uploaded;
+}
+
+//------------ reports ------------
+
+void memory_report(std::ostream &out) {
+	uint64_t live = 0;
+	uint64_t peak = 0;
+	for (size_t t = 0; t < size_t(MemTag::Count); ++t) {
+		MemoryTotals totals = memory_totals(MemTag(t));
+		out << "  heap " << mem_tag_name(MemTag(t)) << ": " << totals.live << " bytes live, " << totals.peak << " peak, " << totals.allocations << " allocations\n";
+		live += totals.live;
+		peak += totals.peak;
+	}
+	out << "  heap total: " << live << " bytes live (sum of peaks " << peak << ")\n";
+	for (size_t k = 0; k < size_t(GLMemKind::Count); ++k) {
+		MemoryTotals totals = gl_memory_totals(GLMemKind(k));
+		out << "  gl " << gl_mem_kind_name(GLMemKind(k)) << ": " << totals.live << " bytes live, " << totals.peak << " peak, " << totals.allocations << " uploads (" << gl_memory_uploaded(GLMemKind(k)) << " bytes)\n";
+	}
+}
+
+bool memory_write_report(std::string const &filename) {
+	std::ofstream out(filename, std::ios::binary);
+	if (!out) {
+		std::cerr << "ERROR: failed to open '" << filename << "' for writing the memory report." << std::endl;
+		return false;
+	}
+	out << "{\n";
+	out << "\t\"heap_allocations\": " << heap_allocations() << ",\n";
+	out << "\t\"heap\": {\n";
+	for (size_t t = 0; t < size_t(MemTag::Count); ++t) {
+		MemoryTotals totals = memory_totals(MemTag(t));
+		out << "\t\t\"" << mem_tag_name(MemTag(t)) << "\": { \"live\": " << totals.live << ", \"peak\": " << totals.peak << ", \"allocations\": " << totals.allocations << " }";
+		out << (t + 1 < size_t(MemTag::Count) ? ",\n" : "\n");
+	}
+	out << "\t},\n";
+	out << "\t\"gl\": {\n";
+	for (size_t k = 0; k < size_t(GLMemKind::Count); ++k) {
+		MemoryTotals totals = gl_memory_totals(GLMemKind(k));
+		out << "\t\t\"" << gl_mem_kind_name(GLMemKind(k)) << "\": { \"live\": " << totals.live << ", \"peak\": " << totals.peak << ", \"uploads\": " << totals.allocations << ", \"uploaded\": " << gl_memory_uploaded(GLMemKind(k)) << " }";
+		out << (k + 1 < size_t(GLMemKind::Count) ? ",\n" : "\n");
+	}
+	out << "\t}\n";
+	out << "}\n";
+	out.close();
+	if (!out) {
+		std::cerr << "ERROR: failed to write memory report to '" << filename << "'." << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void memory_overlay(char *buffer, size_t size) {
+	if (size == 0) return;
+	size_t at = 0;
+	for (size_t t = 0; t < size_t(MemTag::Count) && at < size; ++t) {
+		MemoryTotals totals = memory_totals(MemTag(t));
+		int wrote = std::snprintf(buffer + at, size - at, "%s%s %.1f/%.1fk", (t ? " " : ""), mem_tag_name(MemTag(t)), totals.live / 1024.0, totals.peak / 1024.0);
+		if (wrote < 0) break;
+		at += size_t(wrote);
+	}
+	for (size_t k = 0; k < size_t(GLMemKind::Count) && at < size; ++k) {
+		MemoryTotals totals = gl_memory_totals(GLMemKind(k));
+		int wrote = std::snprintf(buffer + at, size - at, " | gl %s %.1f/%.1fk", gl_mem_kind_name(GLMemKind(k)), totals.live / 1024.0, totals.peak / 1024.0);
+		if (wrote < 0) break;
+		at += size_t(wrote);
+	}
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+#include <stdint.h>
+
+/*
+ * Memory accounting: CPU heap use by subsystem, and what has been handed to GL.
+ *
+ * Global operator new / delete are replaced (in memory_stats.cpp) with
+ * versions that count calls and keep a small header on each block, so
+ * every allocation is charged to the calling thread's current MemTag and
+ * credited back when freed. Set the tag for a scope with MemTagScope.
+ *
+ * GL memory can't be seen from here, so code that creates GL storage
+ * reports it with gl_memory_upload() / gl_memory_delete() (size as
+ * uploaded; drivers may keep more).
+ *
+ * Only link memory_stats.cpp into executables that want the accounting.
+ */
+
+//what an allocation is for:
+enum class MemTag : uint8_t {
+	Other,
+	Assets, //decoded images, shader sources, ...
+	Vertices, //per-frame vertex lists
+	Entities, //entity columns, respawn pool, timers
+	World, //trees and other per-screen state
+	Jobs, //job system queues
+	Rewind, //recent states kept for rewinding
+	Count
+};
+char const *mem_tag_name(MemTag tag);
+
+//charge allocations made on this thread to 'tag' until the end of the scope:
+struct MemTagScope {
+	explicit MemTagScope(MemTag tag);
+	~MemTagScope();
+	MemTagScope(MemTagScope const &) = delete;
+	MemTagScope &operator=(MemTagScope const &) = delete;
+	MemTag previous;
+};
+
+struct MemoryTotals {
+	uint64_t live; //bytes currently allocated
+	uint64_t peak; //most bytes ever live at once
+	uint64_t allocations; //allocations (or uploads) so far
+};
+
+//CPU heap, per tag:
+MemoryTotals memory_totals(MemTag tag);
+
+//operator new calls so far, on all threads:
+uint64_t heap_allocations();
+
+//GL storage, per kind of object:
+enum class GLMemKind : uint8_t {
+	Texture,
+	Buffer,
+	Count
+};
+char const *gl_mem_kind_name(GLMemKind kind);
+
+//GL object 'name' now holds 'bytes' (replacing whatever it held before); call from the GL thread:
+void gl_memory_upload(GLMemKind kind, uint32_t name, uint64_t bytes);
+//GL object 'name' was deleted:
+void gl_memory_delete(GLMemKind kind, uint32_t name);
+//(here 'allocations' counts uploads, and uploaded() the bytes sent, including re-uploads)
+MemoryTotals gl_memory_totals(GLMemKind kind);
+uint64_t gl_memory_uploaded(GLMemKind kind);
+
+//one line per tag and GL kind, live / peak / count:
+void memory_report(std::ostream &out);
+//the same as JSON (for CI to track); returns false if the file couldn't be written:
+bool memory_write_report(std::string const &filename);
+//short one-line summary of live totals (for a window title or overlay), without allocating:
+void memory_overlay(char *buffer, size_t size);
@@ -0,0 +1,41 @@
+#include "pool.hpp"
+
+void SlotMap::reserve(uint32_t count) {
+	slots.reserve(count);
+	dense_slot.reserve(count);
+}
+
+Handle SlotMap::insert() {
+	uint32_t index;
+	if (free_head != Invalid) {
+		index = free_head;
+		free_head = slots[index].dense;
+		slots[index].generation += 1; //(back to even: in use)
+	} else {
+		index = uint32_t(slots.size());
+		slots.emplace_back(Slot{0, 0});
+	}
+	slots[index].dense = uint32_t(dense_slot.size());
+	dense_slot.emplace_back(index);
+
+	Handle handle;
+	handle.index = index;
+	handle.generation = slots[index].generation;
+	return handle;
+}
+
+uint32_t SlotMap::erase(Handle handle) {
+	uint32_t hole = find(handle);
+	assert(hole != Invalid && "erased a stale handle");
+	//move the last item into the hole:
+	uint32_t moved = dense_slot.back();
+	dense_slot[hole] = moved;
+	slots[moved].dense = hole;
+	dense_slot.pop_back();
+	//free the slot, bumping its generation so existing handles go stale:
+	Slot &slot = slots[handle.index];
+	slot.generation += 1;
+	slot.dense = free_head;
+	free_head = handle.index;
+	return hole;
+}
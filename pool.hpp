@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cassert>
+#include <vector>
+#include <stdint.h>
+
+/*
+ * Slot maps: O(1) create and destroy, with the live items kept packed at
+ * the front of dense arrays so loops over them never see holes.
+ *
+ * A Handle names an item by slot index plus that slot's generation. The
+ * generation goes up each time the slot's item is destroyed, so an old
+ * handle to a reused slot is detected as stale instead of silently naming
+ * whatever lives there now.
+ *
+ * SlotMap only does the handle <-> dense index bookkeeping, so that
+ * structure-of-arrays owners (like Entities) can keep their own columns in
+ * dense order; Pool<T> is the plain array-of-T version.
+ *
+ * Nothing allocates once reserve() has made room for the most items that
+ * are ever alive at once: destroyed slots go on a free list and are reused.
+ */
+
+struct Handle {
+	uint32_t index = ~0u;
+	uint32_t generation = 0;
+
+	bool operator==(Handle const &other) const { return index == other.index && generation == other.generation; }
+	bool operator!=(Handle const &other) const { return !(*this == other); }
+
+	//as one integer (e.g. for a TimerWheel payload):
+	uint64_t pack() const { return (uint64_t(generation) << 32) | index; }
+	static Handle unpack(uint64_t packed) {
+		Handle handle;
+		handle.index = uint32_t(packed);
+		handle.generation = uint32_t(packed >> 32);
+		return handle;
+	}
+};
+
+struct SlotMap {
+	static constexpr uint32_t Invalid = ~0u;
+
+	//make room for 'count' items without allocating:
+	void reserve(uint32_t count);
+
+	//new item at dense index size() - 1 (the owner appends its data to match):
+	Handle insert();
+	//destroy the item 'handle' names; returns its old dense index, which the item
+	// at the last dense index has been moved into (the owner does the same move, then pops its last element):
+	uint32_t erase(Handle handle);
+
+	//dense index of the item 'handle' names, or Invalid if it has been destroyed:
+	uint32_t find(Handle handle) const {
+		if (handle.index >= slots.size() || slots[handle.index].generation != handle.generation) return Invalid;
+		return slots[handle.index].dense;
+	}
+	bool valid(Handle handle) const { return find(handle) != Invalid; }
+	//handle of the item at dense index 'dense':
+	Handle handle_at(uint32_t dense) const {
+		Handle handle;
+		handle.index = dense_slot[dense];
+		handle.generation = slots[handle.index].generation;
+		return handle;
+	}
+
+	uint32_t size() const { return uint32_t(dense_slot.size()); }
+
+	//------------ internals ------------
+	struct Slot {
+		uint32_t dense; //dense index of the item, or next free slot (Invalid ends the list)
+		uint32_t generation; //odd while the slot is free (so no handle ever matches a free slot)
+	};
+	std::vector< Slot > slots;
+	std::vector< uint32_t > dense_slot; //slot of each dense item
+	uint32_t free_head = Invalid;
+};
+
+//slot map of T, stored densely:
+template< typename T >
+struct Pool {
+	void reserve(uint32_t count) {
+		map.reserve(count);
+		items.reserve(count);
+	}
+	Handle insert(T const &item) {
+		items.emplace_back(item);
+		return map.insert();
+	}
+	void erase(Handle handle) {
+		uint32_t hole = map.erase(handle);
+		items[hole] = items.back();
+		items.pop_back();
+	}
+	//item 'handle' names, or null if it has been destroyed:
+	T *get(Handle handle) {
+		uint32_t dense = map.find(handle);
+		return (dense == SlotMap::Invalid ? nullptr : &items[dense]);
+	}
+	T const *get(Handle handle) const {
+		uint32_t dense = map.find(handle);
+		return (dense == SlotMap::Invalid ? nullptr : &items[dense]);
+	}
+	uint32_t size() const { return map.size(); }
+
+	SlotMap map;
+	std::vector< T > items; //dense
+};
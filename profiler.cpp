@@ -0,0 +1,153 @@
+#include "profiler.hpp"
+
+#ifdef PROFILER_ENABLED
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+//one completed zone:
+struct ZoneEvent {
+	char const *name;
+	uint64_t start; //ns since profiler epoch
+	uint64_t duration; //ns
+};
+
+//Each thread owns one ring buffer; only that thread writes to it.
+//'written' counts every event ever written, so the reader can tell which
+// slots may have been overwritten while it was copying them.
+struct ThreadBuffer {
+	static constexpr uint32_t Capacity = 1 << 16;
+	ZoneEvent events[Capacity];
+	std::atomic< uint64_t > written{0};
+	std::atomic< char const * > name{nullptr};
+	uint32_t tid = 0;
+};
+
+std::mutex &buffers_mutex() {
+	static std::mutex mutex;
+	return mutex;
+}
+
+std::vector< ThreadBuffer * > &buffers() {
+	static std::vector< ThreadBuffer * > list;
+	return list;
+}
+
+std::chrono::steady_clock::time_point const &epoch() {
+	static std::chrono::steady_clock::time_point const start = std::chrono::steady_clock::now();
+	return start;
+}
+
+uint64_t now_ns() {
+	return std::chrono::duration_cast< std::chrono::nanoseconds >(std::chrono::steady_clock::now() - epoch()).count();
+}
+
+//buffers are never freed, so zones from finished threads stay in the trace:
+ThreadBuffer &thread_buffer() {
+	static thread_local ThreadBuffer *buffer = nullptr;
+	if (!buffer) {
+		buffer = new ThreadBuffer;
+		std::lock_guard< std::mutex > lock(buffers_mutex());
+		buffer->tid = uint32_t(buffers().size());
+		buffers().emplace_back(buffer);
+	}
+	return *buffer;
+}
+
+void write_json_string(std::ostream &out, char const *str) {
+	out << '"';
+	for (char const *c = str; *c; ++c) {
+		if (*c == '"' || *c == '\\') out << '\\';
+		out << *c;
+	}
+	out << '"';
+}
+
+} //namespace
+
+ProfileZone::ProfileZone(char const *name_) : name(name_), start(now_ns()) {
+}
+
+ProfileZone::~ProfileZone() {
+	uint64_t end = now_ns();
+	ThreadBuffer &buffer = thread_buffer();
+	uint64_t index = buffer.written.load(std::memory_order_relaxed);
+	ZoneEvent &event = buffer.events[index % ThreadBuffer::Capacity];
+	event.name = name;
+	event.start = start;
+	event.duration = end - start;
+	buffer.written.store(index + 1, std::memory_order_release);
+}
+
+void profiler_set_thread_name(char const *name) {
+	thread_buffer().name.store(name, std::memory_order_relaxed);
+}
+
+bool profiler_write_trace(std::string const &filename) {
+	std::ofstream out(filename.c_str(), std::ios::binary);
+	if (!out) {
+		std::cerr << "Failed to open '" << filename << "' for profiler trace." << std::endl;
+		return false;
+	}
+
+	std::vector< ThreadBuffer * > list;
+	{
+		std::lock_guard< std::mutex > lock(buffers_mutex());
+		list = buffers();
+	}
+
+	out << "{\"traceEvents\":[\n";
+	bool first = true;
+	auto comma = [&]() {
+		if (!first) out << ",\n";
+		first = false;
+	};
+
+	std::vector< ZoneEvent > events;
+	for (ThreadBuffer *buffer : list) {
+		if (char const *name = buffer->name.load(std::memory_order_relaxed)) {
+			comma();
+			out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << buffer->tid << ",\"args\":{\"name\":";
+			write_json_string(out, name);
+			out << "}}";
+		}
+
+		//copy the newest events, then drop any the owning thread lapped during the copy:
+		uint64_t end = buffer->written.load(std::memory_order_acquire);
+		uint64_t begin = (end > ThreadBuffer::Capacity ? end - ThreadBuffer::Capacity : 0);
+		events.clear();
+		for (uint64_t i = begin; i < end; ++i) {
+			events.emplace_back(buffer->events[i % ThreadBuffer::Capacity]);
+		}
+		uint64_t after = buffer->written.load(std::memory_order_acquire);
+		//(slot i is being rewritten once 'written' reaches i + Capacity)
+		uint64_t lapped = (after + 1 > begin + ThreadBuffer::Capacity ? after + 1 - (begin + ThreadBuffer::Capacity) : 0);
+		if (lapped > events.size()) lapped = events.size();
+
+		for (auto e = events.begin() + lapped; e != events.end(); ++e) {
+			comma();
+			out << "{\"name\":";
+			write_json_string(out, e->name);
+			//trace_event timestamps are in microseconds:
+			out << ",\"ph\":\"X\",\"pid\":0,\"tid\":" << buffer->tid
+			    << ",\"ts\":" << (e->start / 1000) << "." << (e->start % 1000 / 100)
+			    << ",\"dur\":" << (e->duration / 1000) << "." << (e->duration % 1000 / 100)
+			    << "}";
+		}
+	}
+	out << "\n]}\n";
+
+	if (!out) {
+		std::cerr << "Failed to write profiler trace to '" << filename << "'." << std::endl;
+		return false;
+	}
+	return true;
+}
+
+#endif //PROFILER_ENABLED
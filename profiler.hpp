@@ -0,0 +1,50 @@
+#pragma once
+
+/*
+ * Scoped CPU profiler.
+ *
+ * PROFILE_ZONE("name") records the time between its declaration and the end of
+ * the enclosing scope into a ring buffer owned by the calling thread.
+ * Nested zones show up nested in the trace, since they nest in time.
+ *
+ * profiler_write_trace() dumps everything currently in the ring buffers as a
+ * Chrome trace_event JSON file (open with chrome://tracing or ui.perfetto.dev).
+ *
+ * Everything here compiles out when NDEBUG (or PROFILER_DISABLE) is defined.
+ */
+
+#if !defined(NDEBUG) && !defined(PROFILER_DISABLE)
+#define PROFILER_ENABLED 1
+#endif
+
+#ifdef PROFILER_ENABLED
+
+#include <string>
+#include <stdint.h>
+
+struct ProfileZone {
+	explicit ProfileZone(char const *name);
+	~ProfileZone();
+	char const *name;
+	uint64_t start;
+};
+
+//name shown for the calling thread in the trace (name must outlive the profiler):
+void profiler_set_thread_name(char const *name);
+
+//write all buffered zones to 'filename'; returns false if the file couldn't be written:
+bool profiler_write_trace(std::string const &filename);
+
+#define PROFILE_CONCAT2(A, B) A ## B
+#define PROFILE_CONCAT(A, B) PROFILE_CONCAT2(A, B)
+#define PROFILE_ZONE(NAME) ProfileZone PROFILE_CONCAT(profile_zone_, __LINE__)(NAME)
+#define PROFILE_THREAD_NAME(NAME) profiler_set_thread_name(NAME)
+#define PROFILE_WRITE_TRACE(FILENAME) profiler_write_trace(FILENAME)
+
+#else //PROFILER_ENABLED
+
+#define PROFILE_ZONE(NAME) do { } while (0)
+#define PROFILE_THREAD_NAME(NAME) do { } while (0)
+#define PROFILE_WRITE_TRACE(FILENAME) false
+
+#endif //PROFILER_ENABLED
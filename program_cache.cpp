@@ -0,0 +1,130 @@
+#include "program_cache.hpp"
+
+#include <SDL.h>
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+//header of every cache file, followed by 'length' bytes of program binary:
+struct CacheHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t format; //binaryFormat from glGetProgramBinary
+	uint32_t length;
+	float build_seconds;
+};
+constexpr uint32_t CacheVersion = 1;
+
+uint64_t fnv1a(uint64_t hash, std::string const &str) {
+	for (char c : str) {
+		hash ^= uint8_t(c);
+		hash *= 0x100000001b3ULL;
+	}
+	//include a terminator so ("ab","c") and ("a","bc") hash differently:
+	hash ^= 0xff;
+	hash *= 0x100000001b3ULL;
+	return hash;
+}
+
+std::string gl_string(GLenum name) {
+	char const *str = reinterpret_cast< char const * >(glGetString(name));
+	return str ? str : "";
+}
+
+} //namespace
+
+ProgramCache::ProgramCache(std::string const &prefix_) : prefix(prefix_) {
+	driver = gl_string(GL_VENDOR) + '\n' + gl_string(GL_RENDERER) + '\n' + gl_string(GL_VERSION);
+
+	//program binaries are core in 4.1, so on a 3.3 context they come from the extension:
+	if (!SDL_GL_ExtensionSupported("GL_ARB_get_program_binary")) return;
+	GetProgramBinary = (PFNGLGETPROGRAMBINARYPROC)SDL_GL_GetProcAddress("glGetProgramBinary");
+	ProgramBinary = (PFNGLPROGRAMBINARYPROC)SDL_GL_GetProcAddress("glProgramBinary");
+	ProgramParameteri = (PFNGLPROGRAMPARAMETERIPROC)SDL_GL_GetProcAddress("glProgramParameteri");
+	if (!GetProgramBinary || !ProgramBinary || !ProgramParameteri) return;
+
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	supported = (formats > 0);
+}
+
+std::string ProgramCache::filename(std::string const &vertex_source, std::string const &fragment_source) const {
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	hash = fnv1a(hash, vertex_source);
+	hash = fnv1a(hash, fragment_source);
+	hash = fnv1a(hash, driver);
+
+	static char const *hex = "0123456789abcdef";
+	std::string key(16, '0');
+	for (uint32_t i = 0; i < 16; ++i) {
+		key[15 - i] = hex[(hash >> (4 * i)) & 0xf];
+	}
+	return prefix + key + ".progbin";
+}
+
+GLuint ProgramCache::load(std::string const &vertex_source, std::string const &fragment_source) {
+	if (!supported) return 0;
+	auto before = std::chrono::steady_clock::now();
+
+	std::ifstream file(filename(vertex_source, fragment_source).c_str(), std::ios::binary);
+	if (!file) return 0;
+
+	CacheHeader header;
+	if (!file.read(reinterpret_cast< char * >(&header), sizeof(header))) return 0;
+	if (std::memcmp(header.magic, "PBIN", 4) != 0 || header.version != CacheVersion) return 0;
+	std::vector< char > binary(header.length);
+	if (!file.read(binary.data(), binary.size())) return 0;
+
+	GLuint program = glCreateProgram();
+	ProgramBinary(program, header.format, binary.data(), binary.size());
+	GLint link_status = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &link_status);
+	if (link_status != GL_TRUE) {
+		//driver didn't like it; caller will rebuild and store() will overwrite the entry:
+		glDeleteProgram(program);
+		return 0;
+	}
+
+	float load_seconds = std::chrono::duration< float >(std::chrono::steady_clock::now() - before).count();
+	std::cout << "NOTE: loaded cached shader program in " << load_seconds * 1000.0f << " ms"
+	          << " (saved ~" << (header.build_seconds - load_seconds) * 1000.0f << " ms of compile + link)." << std::endl;
+	return program;
+}
+
+void ProgramCache::prepare(GLuint program) const {
+	if (!supported) return;
+	ProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+void ProgramCache::store(GLuint program, std::string const &vertex_source, std::string const &fragment_source, float build_seconds) {
+	if (!supported) return;
+
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) return;
+	std::vector< char > binary(length);
+	GLsizei written = 0;
+	GLenum format = 0;
+	GetProgramBinary(program, length, &written, &format, binary.data());
+	if (written <= 0) return;
+
+	CacheHeader header;
+	std::memcpy(header.magic, "PBIN", 4);
+	header.version = CacheVersion;
+	header.format = format;
+	header.length = uint32_t(written);
+	header.build_seconds = build_seconds;
+
+	std::string name = filename(vertex_source, fragment_source);
+	std::ofstream file(name.c_str(), std::ios::binary);
+	file.write(reinterpret_cast< char const * >(&header), sizeof(header));
+	file.write(binary.data(), written);
+	if (!file) {
+		std::cerr << "NOTE: couldn't write shader program cache '" << name << "'." << std::endl;
+	}
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "GL.hpp"
+
+#include <string>
+#include <stdint.h>
+
+/*
+ * On-disk cache of linked shader programs (GL_ARB_get_program_binary).
+ *
+ * Entries are keyed by a hash of the shader sources and the driver's
+ * GL_VENDOR, GL_RENDERER and GL_VERSION strings, so a driver update or a
+ * shader edit simply misses the cache. Drivers may still reject a binary
+ * (e.g. after an update that didn't change the version string); load()
+ * then returns 0 and the caller compiles as usual.
+ *
+ * Needs a current GL context when constructed.
+ */
+
+struct ProgramCache {
+	//cache files are written as '<prefix><key>.progbin':
+	explicit ProgramCache(std::string const &prefix = "program-");
+
+	//create a program from a cached binary; returns 0 on miss or if the driver rejects the binary:
+	GLuint load(std::string const &vertex_source, std::string const &fragment_source);
+
+	//call before glLinkProgram so the driver keeps a retrievable binary:
+	void prepare(GLuint program) const;
+
+	//save a freshly linked program; 'build_seconds' (compile + link time) is reported on later hits:
+	void store(GLuint program, std::string const &vertex_source, std::string const &fragment_source, float build_seconds);
+
+	bool supported = false;
+	std::string prefix;
+	std::string driver; //vendor + renderer + version, part of every key
+
+	PFNGLGETPROGRAMBINARYPROC GetProgramBinary = nullptr;
+	PFNGLPROGRAMBINARYPROC ProgramBinary = nullptr;
+	PFNGLPROGRAMPARAMETERIPROC ProgramParameteri = nullptr;
+
+	std::string filename(std::string const &vertex_source, std::string const &fragment_source) const;
+};
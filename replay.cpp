@@ -0,0 +1,109 @@
+#include "replay.hpp"
+
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+static uint32_t const ReplayVersion = 2;
+static uint8_t const EndMarker = 0xff;
+
+static void write_varint(std::ostream &out, uint64_t value) {
+	do {
+		uint8_t byte = value & 0x7f;
+		value >>= 7;
+		if (value) byte |= 0x80;
+		out.put(char(byte));
+	} while (value);
+}
+
+static bool read_varint(std::istream &in, uint64_t *value) {
+	*value = 0;
+	for (uint32_t shift = 0; shift < 64; shift += 7) {
+		int c = in.get();
+		if (c == EOF) return false;
+		*value |= uint64_t(c & 0x7f) << shift;
+		if (!(c & 0x80)) return true;
+	}
+	return false;
+}
+
+ReplayRecorder::ReplayRecorder(std::string const &filename_, uint32_t seed, uint32_t animals, float tick_rate) : file(filename_.c_str(), std::ios::binary), filename(filename_) {
+	if (!file) throw std::runtime_error("Failed to open '" + filename + "' for recording.");
+	file.write("FBRP", 4);
+	file.write(reinterpret_cast< char const * >(&ReplayVersion), 4);
+	file.write(reinterpret_cast< char const * >(&seed), 4);
+	file.write(reinterpret_cast< char const * >(&animals), 4);
+	file.write(reinterpret_cast< char const * >(&tick_rate), 4);
+}
+
+ReplayRecorder::~ReplayRecorder() {
+	if (!finished) finish(last_tick + 1);
+}
+
+void ReplayRecorder::record(uint64_t tick, Inputs const &inputs) {
+	for (Action action : inputs.actions) {
+		write_varint(file, tick - last_tick);
+		file.put(char(action));
+		last_tick = tick;
+	}
+}
+
+void ReplayRecorder::finish(uint64_t ticks) {
+	if (finished) return;
+	finished = true;
+	write_varint(file, (ticks > last_tick ? ticks - last_tick : 0));
+	file.put(char(EndMarker));
+	file.flush();
+	if (!file) {
+		std::cerr << "Failed to write replay '" << filename << "'." << std::endl;
+	}
+}
+
+bool Replay::load(std::string const &filename) {
+	std::ifstream file(filename.c_str(), std::ios::binary);
+	if (!file) {
+		std::cerr << "Failed to open replay '" << filename << "'." << std::endl;
+		return false;
+	}
+	char magic[4];
+	uint32_t version = 0;
+	if (!file.read(magic, 4) || std::memcmp(magic, "FBRP", 4) != 0
+	 || !file.read(reinterpret_cast< char * >(&version), 4) || version != ReplayVersion
+	 || !file.read(reinterpret_cast< char * >(&seed), 4)
+	 || !file.read(reinterpret_cast< char * >(&animals), 4)
+	 || !file.read(reinterpret_cast< char * >(&tick_rate), 4)) {
+		std::cerr << "'" << filename << "' is not a (current version) replay file." << std::endl;
+		return false;
+	}
+
+	events.clear();
+	next = 0;
+	uint64_t tick = 0;
+	while (true) {
+		uint64_t delta = 0;
+		int action = EOF;
+		if (!read_varint(file, &delta) || (action = file.get()) == EOF) {
+			std::cerr << "Replay '" << filename << "' is truncated." << std::endl;
+			return false;
+		}
+		tick += delta;
+		if (uint8_t(action) == EndMarker) break;
+		if (uint8_t(action) > uint8_t(Action::Interact)) {
+			std::cerr << "Replay '" << filename << "' contains an unknown action." << std::endl;
+			return false;
+		}
+		events.emplace_back(Event{tick, Action(action)});
+	}
+	ticks = tick;
+	return true;
+}
+
+void Replay::inputs_for(uint64_t tick, Inputs *inputs) {
+	inputs->actions.clear();
+	while (next > 0 && events[next - 1].tick >= tick) --next; //(back up, if the game was rewound)
+	while (next < events.size() && events[next].tick < tick) ++next; //(skip anything already missed)
+	while (next < events.size() && events[next].tick == tick) {
+		inputs->actions.emplace_back(events[next].action);
+		++next;
+	}
+}
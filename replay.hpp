@@ -0,0 +1,61 @@
+#pragma once
+
+#include "game.hpp"
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/*
+ * Input recording and playback.
+ *
+ * A replay file holds the RNG seed, the number of animals (of each kind, per
+ * screen), the tick rate, and every Action along with the tick it was
+ * applied on. Since the simulation only depends on
+ * those, playing a file back reproduces the recorded session exactly, in
+ * both the windowed game and the headless runner.
+ *
+ * Format (native byte order and float layout for the fixed-size fields, as
+ * written by the machine that made it; varints are byte-order independent):
+ *   "FBRP" | u32 version | u32 seed | u32 animals | f32 tick_rate
+ *   then per action: varint (tick - previous tick) | u8 action
+ *   then the end marker: varint (total ticks - previous tick) | u8 0xff
+ */
+
+struct ReplayRecorder {
+	//throws std::runtime_error if 'filename' can't be opened:
+	ReplayRecorder(std::string const &filename, uint32_t seed, uint32_t animals, float tick_rate);
+	~ReplayRecorder(); //calls finish() if needed
+
+	//log the inputs applied on tick 'tick' (ticks must not decrease):
+	void record(uint64_t tick, Inputs const &inputs);
+	//write the end marker; 'ticks' is the total number of ticks simulated:
+	void finish(uint64_t ticks);
+
+	std::ofstream file;
+	std::string filename;
+	uint64_t last_tick = 0;
+	bool finished = false;
+};
+
+struct Replay {
+	//returns false (with a message on std::cerr) if the file is missing or malformed:
+	bool load(std::string const &filename);
+
+	uint32_t seed = 0;
+	uint32_t animals = 1;
+	float tick_rate = 60.0f;
+	uint64_t ticks = 0; //total ticks in the recording
+
+	//fill 'inputs' with the actions for tick 'tick' (ticks normally increase, but may go back after a rewind):
+	void inputs_for(uint64_t tick, Inputs *inputs);
+	bool done(uint64_t tick) const { return tick >= ticks; }
+
+	struct Event {
+		uint64_t tick;
+		Action action;
+	};
+	std::vector< Event > events;
+	size_t next = 0;
+};
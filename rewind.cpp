@@ -0,0 +1,209 @@
+#include "rewind.hpp"
+#include "snapshot.hpp"
+#include "memory_stats.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+RewindBuffer::RewindBuffer(uint64_t ticks, size_t budget, uint32_t keyframe_interval_) : keyframe_interval(keyframe_interval_ ? keyframe_interval_ : 1) {
+	MemTagScope tag(MemTag::Rewind);
+	//(room for a whole keyframe's deltas beyond 'ticks', since they're overwritten along with it)
+	records.resize(size_t(ticks) + keyframe_interval);
+	storage.resize(budget / 8);
+}
+
+void RewindBuffer::clear() {
+	first = 0;
+	count = 0;
+}
+
+void RewindBuffer::drop_oldest() {
+	first = (first + 1) % records.size();
+	count -= 1;
+	//(deltas against the dropped keyframe are no use without it)
+	while (count && records[first].keyframe != records[first].tick) {
+		first = (first + 1) % records.size();
+		count -= 1;
+	}
+}
+
+size_t RewindBuffer::make_room(size_t words) {
+	while (count) {
+		Record const &old = records[first];
+		Record const &last = records[(first + count - 1) % records.size()];
+		size_t end = last.offset + last.words;
+		if (last.offset >= old.offset) {
+			//free space is [end, storage.size()) and [0, old.offset):
+			if (storage.size() - end >= words) return end;
+			if (old.offset >= words) return 0;
+		} else {
+			//(wrapped around) free space is [end, old.offset):
+			if (old.offset - end >= words) return end;
+		}
+		drop_oldest();
+	}
+	return 0;
+}
+
+bool RewindBuffer::encode(Record const &key, size_t limit) {
+	//runs of: a control word (zero words skipped << 32 | changed words that follow), then the changed words, XORed with the keyframe's:
+	uint64_t const *keyframe = storage.data() + key.offset;
+	size_t const words = current.size() / 8;
+	auto word = [&](size_t i) -> uint64_t {
+		uint64_t value;
+		std::memcpy(&value, current.data() + i * 8, 8);
+		return i < key.words ? value ^ keyframe[i] : value;
+	};
+	encoded.clear();
+	size_t i = 0;
+	while (i < words) {
+		uint64_t zeros = 0;
+		while (i < words && word(i) == 0) {
+			zeros += 1;
+			i += 1;
+		}
+		size_t control = encoded.size();
+		encoded.emplace_back(0);
+		uint64_t changed = 0;
+		uint64_t value;
+		while (i < words && (value = word(i)) != 0) {
+			encoded.emplace_back(value);
+			changed += 1;
+			i += 1;
+		}
+		encoded[control] = (zeros << 32) | changed;
+		if (encoded.size() > limit) return false;
+	}
+	return true;
+}
+
+void RewindBuffer::record(GameState const &state) {
+	PROFILE_ZONE("rewind record");
+	MemTagScope tag(MemTag::Rewind);
+	auto before = std::chrono::steady_clock::now();
+
+	if (count && state.ticks != newest() + 1) clear();
+	save_snapshot(state, &current, &sorted);
+	size_t const state_words = current.size() / 8;
+
+	//a delta against the latest keyframe, if there is a recent enough one and the delta is well smaller than a keyframe:
+	bool delta = false;
+	uint64_t keyframe = state.ticks;
+	if (count) {
+		Record const &last = records[(first + count - 1) % records.size()];
+		if (state.ticks - last.keyframe < keyframe_interval) {
+			Record const &key = record_for(last.keyframe);
+			delta = encode(key, key.words / 2);
+			if (delta) keyframe = key.tick;
+		}
+	}
+
+	size_t words = delta ? encoded.size() : state_words;
+	if (words > storage.size()) {
+		//(a keyframe wouldn't fit even with everything else gone)
+		clear();
+		counts.too_big += 1;
+		return;
+	}
+	if (count == records.size()) drop_oldest();
+	size_t offset = make_room(words);
+	if (delta && (count == 0 || keyframe < oldest())) {
+		//(making room overwrote the keyframe this was a delta against, so keep it whole instead)
+		delta = false;
+		keyframe = state.ticks;
+		words = state_words;
+		offset = make_room(words);
+	}
+
+	if (delta) {
+		std::memcpy(storage.data() + offset, encoded.data(), words * 8);
+		counts.deltas += 1;
+		counts.delta_bytes += words * 8;
+	} else {
+		std::memcpy(storage.data() + offset, current.data(), words * 8);
+		counts.keyframes += 1;
+		counts.keyframe_bytes += words * 8;
+	}
+	Record &added = records[(first + count) % records.size()];
+	added.tick = state.ticks;
+	added.keyframe = keyframe;
+	added.offset = offset;
+	added.words = words;
+	added.state_words = state_words;
+	count += 1;
+
+	double seconds = std::chrono::duration< double >(std::chrono::steady_clock::now() - before).count();
+	counts.record_seconds += seconds;
+	counts.record_max_seconds = std::max(counts.record_max_seconds, seconds);
+}
+
+bool RewindBuffer::rewind(uint64_t tick, GameState *state) {
+	PROFILE_ZONE("rewind");
+	if (count == 0 || tick < oldest() || tick > newest()) {
+		std::cerr << "Can't rewind to tick " << tick << ": ";
+		if (count) std::cerr << "only ticks " << oldest() << " to " << newest() << " are kept." << std::endl;
+		else std::cerr << "no ticks are kept." << std::endl;
+		return false;
+	}
+	MemTagScope tag(MemTag::Rewind);
+	auto before = std::chrono::steady_clock::now();
+
+	Record const &target = record_for(tick);
+	Record const &key = record_for(target.keyframe);
+	decoded.resize(target.state_words * 8);
+	if (&target == &key) {
+		std::memcpy(decoded.data(), storage.data() + key.offset, key.words * 8);
+	} else {
+		//start from the keyframe (zeros past its end), then flip the words the delta says changed:
+		size_t common = std::min(key.words, target.state_words);
+		std::memcpy(decoded.data(), storage.data() + key.offset, common * 8);
+		std::memset(decoded.data() + common * 8, 0, (target.state_words - common) * 8);
+		uint64_t const *at = storage.data() + target.offset;
+		uint64_t const *end = at + target.words;
+		size_t i = 0;
+		while (at < end) {
+			uint64_t control = *at++;
+			i += size_t(control >> 32);
+			for (uint64_t changed = control & 0xffffffffULL; changed > 0; --changed, ++i) {
+				uint64_t value;
+				std::memcpy(&value, decoded.data() + i * 8, 8);
+				value ^= *at++;
+				std::memcpy(decoded.data() + i * 8, &value, 8);
+			}
+		}
+	}
+	if (!load_snapshot(decoded.data(), decoded.size(), state)) return false;
+	count = size_t(tick - oldest()) + 1; //(the ticks after this one are the future now)
+
+	double seconds = std::chrono::duration< double >(std::chrono::steady_clock::now() - before).count();
+	counts.rewinds += 1;
+	counts.rewind_seconds += seconds;
+	counts.rewind_max_seconds = std::max(counts.rewind_max_seconds, seconds);
+	return true;
+}
+
+void RewindBuffer::report(std::ostream &out) const {
+	size_t used = 0;
+	for (size_t i = 0; i < count; ++i) {
+		used += records[(first + i) % records.size()].words * 8;
+	}
+	out << "Rewind: ";
+	if (count) out << "ticks " << oldest() << " to " << newest() << " kept";
+	else out << "nothing kept";
+	out << " in " << used << " of " << storage.size() * 8 << " bytes; recorded " << counts.keyframes << " keyframes";
+	if (counts.keyframes) out << " (" << counts.keyframe_bytes / counts.keyframes << " bytes each)";
+	out << " and " << counts.deltas << " deltas";
+	if (counts.deltas) out << " (" << counts.delta_bytes / counts.deltas << " bytes each)";
+	if (counts.too_big) out << ", " << counts.too_big << " states too big to keep";
+	uint64_t recorded = counts.keyframes + counts.deltas + counts.too_big;
+	if (recorded) {
+		out << "; " << counts.record_seconds * 1000.0 / double(recorded) << " ms per tick (max " << counts.record_max_seconds * 1000.0 << " ms)";
+	}
+	if (counts.rewinds) {
+		out << "; " << counts.rewinds << " rewinds, " << counts.rewind_seconds * 1000.0 / double(counts.rewinds) << " ms each (max " << counts.rewind_max_seconds * 1000.0 << " ms)";
+	}
+	out << "." << std::endl;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "game.hpp"
+
+#include <iosfwd>
+#include <vector>
+#include <stdint.h>
+
+/*
+ * Keeping the last few seconds of game state, so the game can be stepped
+ * backwards (for debugging, and for scrubbing through replays).
+ *
+ * After each tick, record() serializes the state as a snapshot (see
+ * snapshot.hpp). Every keyframe_interval ticks the snapshot is kept whole,
+ * as a keyframe. In between, only the XOR of its words with the latest
+ * keyframe's words is kept, leaving out runs of zero words (everything that
+ * hasn't changed). Most of a snapshot doesn't change between ticks, so these
+ * deltas are small. Each delta is against a keyframe, not the tick before,
+ * so rewinding to any kept tick decodes at most two records: about the cost
+ * of loading one snapshot.
+ *
+ * Records live in one fixed-size block, and the oldest are overwritten
+ * first: a keyframe goes together with the deltas that need it. So memory
+ * use never grows past the budget. The number of ticks kept is capped too.
+ */
+
+struct RewindBuffer {
+	//keep up to (about) the latest 'ticks' ticks in at most 'budget' bytes, with a keyframe every 'keyframe_interval' ticks:
+	RewindBuffer(uint64_t ticks, size_t budget, uint32_t keyframe_interval = 60);
+
+	//(after each tick) keep the state; if it doesn't follow on from the newest tick kept, everything kept is forgotten first:
+	void record(GameState const &state);
+	//forget everything kept (e.g. after loading a snapshot):
+	void clear();
+
+	bool empty() const { return count == 0; }
+	//the range of ticks (GameState::ticks) that can be rewound to, if not empty():
+	uint64_t oldest() const { return records[first].tick; }
+	uint64_t newest() const { return records[(first + count - 1) % records.size()].tick; }
+
+	//replace 'state' with the state as of 'tick' and forget the ticks kept after it (an attached world saver's file
+	// is rewritten to match; see load_snapshot). Returns false (with a
+	// message on std::cerr), leaving 'state' alone, if 'tick' isn't between oldest() and newest() or its state fails to load:
+	bool rewind(uint64_t tick, GameState *state);
+
+	struct Stats {
+		uint64_t keyframes = 0; //recorded
+		uint64_t deltas = 0;
+		uint64_t delta_bytes = 0; //total, for the average
+		uint64_t keyframe_bytes = 0;
+		uint64_t too_big = 0; //states that didn't fit in the whole budget (and weren't kept)
+		double record_seconds = 0.0;
+		double record_max_seconds = 0.0;
+		uint64_t rewinds = 0;
+		double rewind_seconds = 0.0;
+		double rewind_max_seconds = 0.0;
+	};
+	Stats const &stats() const { return counts; }
+	void report(std::ostream &out) const;
+
+	//------------ internals ------------
+	struct Record {
+		uint64_t tick;
+		uint64_t keyframe; //tick of the keyframe this is a delta against (its own tick, for a keyframe)
+		size_t offset; //words into 'storage'
+		size_t words; //in 'storage'
+		size_t state_words; //of the snapshot it decodes to
+	};
+	std::vector< Record > records; //a ring; the oldest is records[first]
+	size_t first = 0;
+	size_t count = 0;
+	std::vector< uint64_t > storage; //records' words, each contiguous, as a ring in the same order
+	uint32_t keyframe_interval;
+	Stats counts;
+
+	//scratch, kept so recording doesn't allocate once warmed up:
+	std::vector< uint8_t > current; //the snapshot being recorded
+	std::vector< ChunkDelta > sorted; //its deltas, in the order they're saved
+	std::vector< uint64_t > encoded; //its delta
+	std::vector< uint8_t > decoded; //the snapshot being rewound to
+
+	Record const &record_for(uint64_t tick) const { return records[(first + size_t(tick - oldest())) % records.size()]; }
+	//XOR 'current' against 'key' into 'encoded'; false if that would take more than 'limit' words:
+	bool encode(Record const &key, size_t limit);
+	//where 'words' words can go, overwriting the oldest records as needed:
+	size_t make_room(size_t words);
+	void drop_oldest();
+};
@@ -0,0 +1,65 @@
+#include "rng.hpp"
+
+//splitmix64, used to expand seeds into generator state:
+static uint64_t splitmix64(uint64_t *x) {
+	uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+//mix seed and stream so nearby (seed, stream) pairs give unrelated states:
+static uint64_t seed_state(uint64_t seed, uint64_t stream) {
+	uint64_t x = seed;
+	uint64_t a = splitmix64(&x);
+	x = stream ^ a;
+	return splitmix64(&x);
+}
+
+Rng::Rng(uint64_t seed, uint64_t stream) {
+	uint64_t x = seed_state(seed, stream);
+	uint64_t a = splitmix64(&x);
+	uint64_t b = splitmix64(&x);
+	s[0] = uint32_t(a);
+	s[1] = uint32_t(a >> 32);
+	s[2] = uint32_t(b);
+	s[3] = uint32_t(b >> 32);
+	//xoshiro must not start from all-zero state:
+	if ((s[0] | s[1] | s[2] | s[3]) == 0) s[0] = 1;
+}
+
+RngBatch::RngBatch(uint64_t seed, uint64_t stream) {
+	uint64_t x = seed_state(seed, stream);
+	for (uint32_t l = 0; l < Lanes; ++l) {
+		uint64_t a = splitmix64(&x);
+		uint64_t b = splitmix64(&x);
+		s0[l] = uint32_t(a);
+		s1[l] = uint32_t(a >> 32);
+		s2[l] = uint32_t(b);
+		s3[l] = uint32_t(b >> 32);
+		if ((s0[l] | s1[l] | s2[l] | s3[l]) == 0) s0[l] = 1;
+	}
+}
+
+void RngBatch::uniform(float *out, size_t count, float a, float b) {
+	float const scale = (b - a) * (1.0f / 16777216.0f);
+	float block[Lanes];
+	for (size_t i = 0; i < count; i += Lanes) {
+		//one xoshiro128+ step in every lane (no cross-lane dependencies):
+		for (uint32_t l = 0; l < Lanes; ++l) {
+			uint32_t result = s0[l] + s3[l];
+			uint32_t t = s1[l] << 9;
+			s2[l] ^= s0[l];
+			s3[l] ^= s1[l];
+			s1[l] ^= s2[l];
+			s0[l] ^= s3[l];
+			s2[l] ^= t;
+			s3[l] = (s3[l] << 11) | (s3[l] >> 21);
+			block[l] = a + float(result >> 8) * scale;
+		}
+		size_t n = (count - i < Lanes ? count - i : Lanes);
+		for (size_t l = 0; l < n; ++l) {
+			out[i + l] = block[l];
+		}
+	}
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <stdint.h>
+
+/*
+ * Small, fast, explicitly-seeded random number generators (xoshiro128 family).
+ *
+ * Unlike rand(), every generator carries its own state, so results don't
+ * depend on libc, on call order elsewhere in the program, or on which
+ * thread is running. Give each entity (or thread) its own stream to keep
+ * parallel and replayed simulation deterministic.
+ */
+
+//one xoshiro128** generator:
+struct Rng {
+	Rng() : Rng(0) { }
+	//generators with the same seed but different streams are independent:
+	explicit Rng(uint64_t seed, uint64_t stream = 0);
+
+	uint32_t next() {
+		uint32_t result = rotl(s[1] * 5, 7) * 9;
+		uint32_t t = s[1] << 9;
+		s[2] ^= s[0];
+		s[3] ^= s[1];
+		s[1] ^= s[2];
+		s[0] ^= s[3];
+		s[2] ^= t;
+		s[3] = rotl(s[3], 11);
+		return result;
+	}
+
+	//uniform in [0,1):
+	float uniform() {
+		return float(next() >> 8) * (1.0f / 16777216.0f);
+	}
+	//uniform in [a,b):
+	float uniform(float a, float b) {
+		return a + uniform() * (b - a);
+	}
+
+	static uint32_t rotl(uint32_t x, int k) {
+		return (x << k) | (x >> (32 - k));
+	}
+
+	uint32_t s[4];
+};
+
+//Eight interleaved xoshiro128+ generators, stored lane-by-lane so that the
+// batch fill loop compiles to SIMD; for spawning many things at once:
+struct RngBatch {
+	static constexpr uint32_t Lanes = 8;
+
+	explicit RngBatch(uint64_t seed, uint64_t stream = 0);
+
+	//write 'count' uniform floats in [a,b) to 'out':
+	void uniform(float *out, size_t count, float a, float b);
+
+	uint32_t s0[Lanes], s1[Lanes], s2[Lanes], s3[Lanes];
+};
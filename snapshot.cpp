@@ -0,0 +1,503 @@
+#include "snapshot.hpp"
+#include "atomic_file.hpp"
+#include "world_save.hpp"
+#include "profiler.hpp"
+#include "memory_stats.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <type_traits>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static uint32_t const SnapshotVersion = 1;
+
+struct SnapshotHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t seed;
+	uint32_t animals;
+	uint64_t size; //payload bytes after the header
+	uint64_t hash; //of the payload
+};
+static_assert(sizeof(SnapshotHeader) == SnapshotHeaderSize, "payload starts 8-byte aligned");
+
+//GameState's plain fields, copied as one section:
+struct Scalars {
+	glm::vec2 playerpos;
+	glm::vec2 previous_playerpos;
+	glm::ivec2 heading;
+	Handle wizard;
+	ChunkCoord wizard_chunk;
+	uint32_t screen;
+	float playerHealth;
+	float playerTemp;
+	float healthDecay;
+	float tempDecay;
+	int32_t lumber;
+	int32_t meat;
+	float meatRegen;
+	float wizardRegen;
+	int32_t treeCollideInstance;
+	float playerSpeed;
+	float treeGrowRate;
+	float boxSizeMultiplier;
+	float treeBox;
+	float totalTime;
+	uint32_t padding; //(spelled out, so every byte is set and equal states hash the same)
+	uint64_t ticks;
+	//timer wheel bookkeeping:
+	uint64_t timers_current;
+	uint64_t timers_count;
+	uint32_t timers_free;
+	uint32_t respawns_free;
+};
+static_assert(sizeof(Scalars) == 136, "Scalars has no hidden padding");
+
+SnapshotHash::SnapshotHash(uint64_t payload_size) : value(0x9e3779b97f4a7c15ULL ^ payload_size) {
+}
+
+void SnapshotHash::add(uint8_t const *data, size_t size) {
+	assert(size % 8 == 0 && "payload pieces are whole words");
+	for (size_t i = 0; i < size; i += 8) {
+		uint64_t word;
+		std::memcpy(&word, data + i, 8);
+		value = (value ^ word) * 0xff51afd7ed558ccdULL;
+		value ^= value >> 32;
+	}
+}
+
+static uint64_t hash_payload(uint8_t const *data, size_t size) {
+	SnapshotHash hash(size);
+	hash.add(data, size);
+	return hash.value;
+}
+
+//------------ writing ------------
+
+struct Writer {
+	std::vector< uint8_t > &out;
+
+	void bytes(void const *data, size_t size) {
+		size_t at = out.size();
+		out.resize(at + ((size + 7) & ~size_t(7)), 0);
+		if (size) std::memcpy(out.data() + at, data, size);
+	}
+	template< typename T >
+	void value(T const &item) {
+		static_assert(std::is_trivially_copyable< T >::value, "sections are copied bytewise");
+		bytes(&item, sizeof(T));
+	}
+	template< typename T >
+	void array(std::vector< T > const &items) {
+		static_assert(std::is_trivially_copyable< T >::value, "sections are copied bytewise");
+		uint64_t count = items.size();
+		bytes(&count, 8);
+		bytes(items.data(), items.size() * sizeof(T));
+	}
+};
+
+static void write_slot_map(Writer &w, SlotMap const &map) {
+	w.array(map.slots);
+	w.array(map.dense_slot);
+}
+
+static void write_entities(Writer &w, Entities const &e) {
+	w.array(e.kind);
+	w.array(e.x);
+	w.array(e.y);
+	w.array(e.prev_x);
+	w.array(e.prev_y);
+	w.array(e.speed);
+	w.array(e.base_speed);
+	w.array(e.aggro);
+	w.array(e.damage);
+	w.array(e.meat);
+	w.array(e.respawn_time);
+	w.array(e.collide);
+	w.array(e.rng);
+	write_slot_map(w, e.handles);
+	w.value(e.handles.free_head);
+	w.array(e.collided);
+}
+
+void snapshot_head(GameState const &s, std::vector< uint8_t > *out) {
+	Writer w{*out};
+	Scalars scalars;
+	scalars.padding = 0;
+	scalars.playerpos = s.playerpos;
+	scalars.previous_playerpos = s.previous_playerpos;
+	scalars.heading = s.heading;
+	scalars.wizard = s.wizard;
+	scalars.wizard_chunk = s.wizard_chunk;
+	scalars.screen = s.screen;
+	scalars.playerHealth = s.playerHealth;
+	scalars.playerTemp = s.playerTemp;
+	scalars.healthDecay = s.healthDecay;
+	scalars.tempDecay = s.tempDecay;
+	scalars.lumber = s.lumber;
+	scalars.meat = s.meat;
+	scalars.meatRegen = s.meatRegen;
+	scalars.wizardRegen = s.wizardRegen;
+	scalars.treeCollideInstance = s.treeCollideInstance;
+	scalars.playerSpeed = s.playerSpeed;
+	scalars.treeGrowRate = s.treeGrowRate;
+	scalars.boxSizeMultiplier = s.boxSizeMultiplier;
+	scalars.treeBox = s.treeBox;
+	scalars.totalTime = s.totalTime;
+	scalars.ticks = s.ticks;
+	scalars.timers_current = s.timers.current;
+	scalars.timers_count = s.timers.count;
+	scalars.timers_free = s.timers.free_nodes;
+	scalars.respawns_free = s.respawns.map.free_head;
+	w.value(scalars);
+	uint64_t screens = s.screens.size();
+	w.value(screens);
+}
+
+void snapshot_screen(Screen const &at, std::vector< uint8_t > *out) {
+	Writer w{*out};
+	w.value(at.coord);
+	w.value(at.respawning);
+	w.array(at.trees.x);
+	w.array(at.trees.y);
+	w.array(at.trees.grown_at);
+	write_entities(w, at.entities);
+}
+
+void snapshot_tail(GameState const &s, std::vector< uint8_t > *out, std::vector< ChunkDelta > *scratch) {
+	Writer w{*out};
+	w.array(s.left);
+
+	//deltas, in key order (so equal states give equal files):
+	std::vector< ChunkDelta > temporary;
+	std::vector< ChunkDelta > &deltas = (scratch ? *scratch : temporary);
+	deltas.clear();
+	deltas.reserve(s.deltas.size());
+	for (auto const &entry : s.deltas) {
+		deltas.emplace_back(entry.second);
+	}
+	std::sort(deltas.begin(), deltas.end(), [](ChunkDelta const &a, ChunkDelta const &b) {
+		return a.coord.key() < b.coord.key();
+	});
+	w.array(deltas);
+
+	//pending respawns and their timers:
+	write_slot_map(w, s.respawns.map);
+	w.array(s.respawns.items);
+	w.array(s.timers.nodes);
+	w.value(s.timers.slots);
+	w.value(s.timers.far);
+}
+
+void snapshot_header(uint32_t seed, uint32_t animals, uint64_t payload_size, uint64_t hash, uint8_t *out) {
+	SnapshotHeader header;
+	std::memcpy(header.magic, "FBSS", 4);
+	header.version = SnapshotVersion;
+	header.seed = seed;
+	header.animals = animals;
+	header.size = payload_size;
+	header.hash = hash;
+	std::memcpy(out, &header, sizeof(header));
+}
+
+void save_snapshot(GameState const &s, std::vector< uint8_t > *out, std::vector< ChunkDelta > *scratch) {
+	PROFILE_ZONE("save snapshot");
+	out->clear();
+	out->resize(SnapshotHeaderSize);
+	snapshot_head(s, out);
+	for (Screen const &at : s.screens) {
+		snapshot_screen(at, out);
+	}
+	snapshot_tail(s, out, scratch);
+	uint64_t size = out->size() - SnapshotHeaderSize;
+	snapshot_header(s.seed, s.animals, size, hash_payload(out->data() + SnapshotHeaderSize, size_t(size)), out->data());
+}
+
+bool save_snapshot(GameState const &state, std::string const &filename) {
+	std::vector< uint8_t > bytes;
+	save_snapshot(state, &bytes);
+	return write_file_atomically(filename, std::vector< FilePiece >{FilePiece{bytes.data(), bytes.size()}});
+}
+
+//------------ loading ------------
+
+//a whole file, mapped read-only:
+struct MappedFile {
+	uint8_t const *data = nullptr;
+	size_t size = 0;
+
+	//false if it can't be opened or mapped (e.g. it doesn't exist, or is empty):
+	bool open(std::string const &filename) {
+#ifdef _WIN32
+		file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) return false;
+		LARGE_INTEGER length;
+		if (!GetFileSizeEx(file, &length) || length.QuadPart == 0) return false;
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!mapping) return false;
+		void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (!view) return false;
+		data = reinterpret_cast< uint8_t const * >(view);
+		size = size_t(length.QuadPart);
+#else
+		fd = ::open(filename.c_str(), O_RDONLY);
+		if (fd < 0) return false;
+		struct stat info;
+		if (fstat(fd, &info) != 0 || info.st_size == 0) return false;
+		void *view = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		if (view == MAP_FAILED) return false;
+		data = reinterpret_cast< uint8_t const * >(view);
+		size = size_t(info.st_size);
+#endif
+		return true;
+	}
+
+	~MappedFile() {
+#ifdef _WIN32
+		if (data) UnmapViewOfFile(data);
+		if (mapping) CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+		if (data) munmap(const_cast< uint8_t * >(data), size);
+		if (fd >= 0) close(fd);
+#endif
+	}
+
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+#else
+	int fd = -1;
+#endif
+};
+
+struct Reader {
+	Reader(uint8_t const *begin, uint8_t const *end_) : at(begin), end(end_) { }
+	uint8_t const *at;
+	uint8_t const *end;
+	bool ok = true; //false once anything ran past the end
+
+	bool bytes(void *data, size_t size) {
+		size_t padded = (size + 7) & ~size_t(7);
+		if (!ok || size_t(end - at) < padded) return (ok = false);
+		if (size) std::memcpy(data, at, size);
+		at += padded;
+		return true;
+	}
+	template< typename T >
+	bool value(T *item) {
+		static_assert(std::is_trivially_copyable< T >::value, "sections are copied bytewise");
+		return bytes(item, sizeof(T));
+	}
+	template< typename T >
+	bool array(std::vector< T > *items) {
+		static_assert(std::is_trivially_copyable< T >::value, "sections are copied bytewise");
+		uint64_t count = 0;
+		if (!bytes(&count, 8)) return false;
+		if (count > uint64_t(end - at) / sizeof(T)) return (ok = false);
+		items->resize(size_t(count));
+		return bytes(items->data(), size_t(count) * sizeof(T));
+	}
+};
+
+static void read_slot_map(Reader &r, SlotMap *map) {
+	r.array(&map->slots);
+	r.array(&map->dense_slot);
+}
+
+static void read_entities(Reader &r, Entities *e, uint32_t reserve) {
+	//(room for everything that respawns, as when generated)
+	e->reserve(reserve);
+	r.array(&e->kind);
+	r.array(&e->x);
+	r.array(&e->y);
+	r.array(&e->prev_x);
+	r.array(&e->prev_y);
+	r.array(&e->speed);
+	r.array(&e->base_speed);
+	r.array(&e->aggro);
+	r.array(&e->damage);
+	r.array(&e->meat);
+	r.array(&e->respawn_time);
+	r.array(&e->collide);
+	r.array(&e->rng);
+	read_slot_map(r, &e->handles);
+	r.value(&e->handles.free_head);
+	r.array(&e->collided);
+	size_t count = e->kind.size();
+	if (e->x.size() != count || e->y.size() != count || e->prev_x.size() != count || e->prev_y.size() != count
+	 || e->speed.size() != count || e->base_speed.size() != count || e->aggro.size() != count
+	 || e->damage.size() != count || e->meat.size() != count || e->respawn_time.size() != count
+	 || e->collide.size() != count || e->rng.size() != count || e->handles.dense_slot.size() != count) {
+		r.ok = false;
+	}
+}
+
+//load the snapshot file in data[0..size) ('filename' is for messages):
+static bool load_snapshot_bytes(uint8_t const *data, size_t size, std::string const &filename, GameState *state) {
+	SnapshotHeader header;
+	if (size < sizeof(header)
+	 || (std::memcpy(&header, data, sizeof(header)), std::memcmp(header.magic, "FBSS", 4) != 0)
+	 || header.version != SnapshotVersion) {
+		std::cerr << "'" << filename << "' is not a (current version) snapshot." << std::endl;
+		return false;
+	}
+	uint8_t const *payload = data + sizeof(header);
+	if (header.size != size - sizeof(header) || header.size % 8 != 0
+	 || hash_payload(payload, size_t(header.size)) != header.hash) {
+		std::cerr << "Snapshot '" << filename << "' is damaged (its size or hash doesn't match)." << std::endl;
+		return false;
+	}
+	if ((state->streamer || state->saver) && (header.seed != state->seed || header.animals != state->animals)) {
+		std::cerr << "Snapshot '" << filename << "' is of a different world (seed " << header.seed << ", " << header.animals << " animals) than this game's." << std::endl;
+		return false;
+	}
+
+	//(everything is read into temporaries first, and only moved into 'state' once it has all checked out)
+	Reader r{payload, payload + header.size};
+	Scalars scalars;
+	r.value(&scalars);
+
+	//chunks:
+	uint64_t count = 0;
+	r.value(&count);
+	if (count == 0 || count > header.size) {
+		r.ok = false;
+		count = 0;
+	}
+	std::vector< Screen > screens;
+	{
+		MemTagScope tag(MemTag::Entities);
+		screens.reserve(std::max< size_t >(size_t(count), 2 * GameState::KeepRecent));
+		screens.resize(size_t(count));
+	}
+	for (Screen &at : screens) {
+		if (!r.ok) break;
+		r.value(&at.coord);
+		r.value(&at.respawning);
+		{
+			MemTagScope tag(MemTag::World);
+			Trees &trees = at.trees;
+			r.array(&trees.x);
+			r.array(&trees.y);
+			r.array(&trees.grown_at);
+			if (trees.y.size() != trees.x.size() || trees.grown_at.size() != trees.x.size()) r.ok = false;
+			for (uint32_t i = 0; i < trees.x.size() && r.ok; ++i) {
+				trees.grid.insert(i, glm::vec2(trees.x[i], trees.y[i]));
+			}
+		}
+		MemTagScope tag(MemTag::Entities);
+		read_entities(r, &at.entities, 3 * header.animals + (at.coord == scalars.wizard_chunk ? 1 : 0));
+	}
+	std::vector< ChunkCoord > left;
+	{
+		MemTagScope tag(MemTag::Entities);
+		left.reserve(2 * GameState::KeepRecent);
+		r.array(&left);
+	}
+	if (scalars.screen >= screens.size()) r.ok = false;
+
+	std::vector< ChunkDelta > deltas;
+	r.array(&deltas);
+
+	Pool< Respawn > respawns;
+	TimerWheel timers;
+	{
+		MemTagScope tag(MemTag::Entities);
+		uint32_t reserve = 3 * header.animals * GameState::KeepRecent;
+		respawns.reserve(reserve);
+		timers.reserve(reserve);
+		read_slot_map(r, &respawns.map);
+		r.array(&respawns.items);
+		r.array(&timers.nodes);
+		r.value(&timers.slots);
+		r.value(&timers.far);
+		if (respawns.items.size() != respawns.map.dense_slot.size()) r.ok = false;
+	}
+
+	if (!r.ok || r.at != r.end) {
+		//(the hash matched, so this was written wrong)
+		std::cerr << "Snapshot '" << filename << "' doesn't hold a consistent game state (the game is left as it was)." << std::endl;
+		return false;
+	}
+
+	//it all checks out, so replace the state:
+	GameState &s = *state;
+	s.seed = header.seed;
+	s.animals = header.animals;
+	s.playerpos = scalars.playerpos;
+	s.previous_playerpos = scalars.previous_playerpos;
+	s.heading = scalars.heading;
+	s.wizard = scalars.wizard;
+	s.wizard_chunk = scalars.wizard_chunk;
+	s.screen = scalars.screen;
+	s.playerHealth = scalars.playerHealth;
+	s.playerTemp = scalars.playerTemp;
+	s.healthDecay = scalars.healthDecay;
+	s.tempDecay = scalars.tempDecay;
+	s.lumber = scalars.lumber;
+	s.meat = scalars.meat;
+	s.meatRegen = scalars.meatRegen;
+	s.wizardRegen = scalars.wizardRegen;
+	s.treeCollideInstance = scalars.treeCollideInstance;
+	s.playerSpeed = scalars.playerSpeed;
+	s.treeGrowRate = scalars.treeGrowRate;
+	s.boxSizeMultiplier = scalars.boxSizeMultiplier;
+	s.treeBox = scalars.treeBox;
+	s.totalTime = scalars.totalTime;
+	s.ticks = scalars.ticks;
+
+	s.screens.swap(screens);
+	s.left.swap(left);
+	{
+		MemTagScope tag(MemTag::World);
+		s.loaded.clear();
+		for (uint32_t index = 0; index < s.screens.size(); ++index) {
+			Screen &at = s.screens[index];
+			at.version = ++s.versions; //(new contents, as far as savers that compare versions know)
+			s.loaded[at.coord.key()] = index;
+		}
+		s.deltas.clear();
+		for (ChunkDelta const &delta : deltas) {
+			s.deltas.emplace(delta.coord.key(), delta);
+		}
+	}
+
+	s.respawns = std::move(respawns);
+	s.respawns.map.free_head = scalars.respawns_free;
+	s.timers = std::move(timers);
+	s.timers.current = scalars.timers_current;
+	s.timers.count = size_t(scalars.timers_count);
+	s.timers.free_nodes = scalars.timers_free;
+
+	//(the world save has changes the loaded state may not, e.g. trees cut since the snapshot was taken)
+	if (s.saver) s.saver->rewrite(s);
+	return true;
+}
+
+bool load_snapshot(std::string const &filename, GameState *state) {
+	PROFILE_ZONE("load snapshot");
+	MappedFile file;
+	if (!file.open(filename)) {
+		std::cerr << "Failed to open snapshot '" << filename << "'." << std::endl;
+		return false;
+	}
+	return load_snapshot_bytes(file.data, file.size, filename, state);
+}
+
+bool load_snapshot(uint8_t const *data, size_t size, GameState *state) {
+	PROFILE_ZONE("load snapshot");
+	return load_snapshot_bytes(data, size, "(in memory)", state);
+}
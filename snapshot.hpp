@@ -0,0 +1,67 @@
+#pragma once
+
+#include "game.hpp"
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/*
+ * Saving and loading the whole game state.
+ *
+ * A snapshot is everything in GameState that the simulation reads: the
+ * player, every loaded chunk (trees and entities, including their handle
+ * tables), the chunk deltas, pending respawns and the timer wheel. So a game
+ * continued from a snapshot plays out exactly like the game it was taken
+ * from. Lookup tables (GameState::loaded, tree grids) are rebuilt on load.
+ *
+ * Each trivially copyable part (a column of entities, the timer wheel's
+ * slot table, the player's fields) is one section, copied with a single
+ * memcpy each way. Loading maps the file into memory and copies each
+ * section straight out of the mapping. Normal worlds take well under a
+ * millisecond either way.
+ *
+ * Format (native byte order and float layout, since snapshots are quick
+ * saves rather than an exchange format):
+ *   "FBSS" | u32 version | u32 seed | u32 animals | u64 payload bytes | u64 payload hash
+ *   then the payload: sections, each padded to 8 bytes; arrays are a u64
+ *   count followed by the elements.
+ * Bump SnapshotVersion in snapshot.cpp whenever what's saved changes.
+ *
+ * Files are replaced atomically (see atomic_file.hpp), so a crash while
+ * saving leaves the previous snapshot intact.
+ */
+
+//serialize 'state' into 'out' (a whole snapshot file's bytes, reusing out's capacity); if 'scratch' is given,
+// the deltas are sorted in it rather than in a temporary, so saving again and again needn't allocate:
+void save_snapshot(GameState const &state, std::vector< uint8_t > *out, std::vector< ChunkDelta > *scratch = nullptr);
+//write a snapshot of 'state' to 'filename'; returns false (with a message on std::cerr) if it can't be written:
+bool save_snapshot(GameState const &state, std::string const &filename);
+
+//------------ a piece at a time ------------
+//(for savers that keep the bytes of chunks that haven't changed since they last saved; see autosave.hpp)
+//A snapshot file is a header, then a payload made of snapshot_head(), snapshot_screen() for each of
+// state.screens in order, and snapshot_tail(). Each appends to 'out', in whole 8-byte words:
+void snapshot_head(GameState const &state, std::vector< uint8_t > *out);
+void snapshot_screen(Screen const &screen, std::vector< uint8_t > *out);
+void snapshot_tail(GameState const &state, std::vector< uint8_t > *out, std::vector< ChunkDelta > *scratch = nullptr);
+
+//hash of a payload, added a piece at a time:
+struct SnapshotHash {
+	explicit SnapshotHash(uint64_t payload_size);
+	void add(uint8_t const *data, size_t size);
+	uint64_t value;
+};
+
+constexpr size_t SnapshotHeaderSize = 32;
+//write the header for a payload of 'payload_size' bytes with hash 'hash' into 'out' (SnapshotHeaderSize bytes):
+void snapshot_header(uint32_t seed, uint32_t animals, uint64_t payload_size, uint64_t hash, uint8_t *out);
+
+//replace 'state' with the snapshot in 'filename' (its streamer and saver stay attached, so if it has either,
+// the snapshot must be of the same world: seed and animals; an attached saver's file is rewritten to hold
+// just the loaded deltas). Returns false (with a message on std::cerr),
+// leaving 'state' alone, if the file is missing, isn't a snapshot of this version, fails its hash check,
+// is of another world, or doesn't hold a consistent state (it's all read and checked before 'state' changes):
+bool load_snapshot(std::string const &filename, GameState *state);
+//the same, from a whole snapshot file's bytes already in memory (as save_snapshot() makes them):
+bool load_snapshot(uint8_t const *data, size_t size, GameState *state);
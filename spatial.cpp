@@ -0,0 +1,83 @@
+#include "spatial.hpp"
+
+#include <cassert>
+
+SpatialHash::SpatialHash(float cell_size_) : cell_size(cell_size_), inv_cell_size(1.0f / cell_size_), kernels(&aabb_kernels()) {
+	buckets.resize(64);
+}
+
+void SpatialHash::insert(uint32_t id, glm::vec2 const &position) {
+	if (id >= slots.size()) slots.resize(id + 1, Slot{Absent, 0});
+	assert(slots[id].bucket == Absent && "inserted the same id twice");
+	if (count + 1 > 2 * buckets.size()) grow();
+
+	uint32_t b = bucket(cell(position.x), cell(position.y));
+	slots[id] = Slot{b, buckets[b].size()};
+	buckets[b].push(id, position);
+	++count;
+}
+
+void SpatialHash::move(uint32_t id, glm::vec2 const &position) {
+	assert(id < slots.size() && slots[id].bucket != Absent);
+	Slot const &slot = slots[id];
+	if (bucket(cell(position.x), cell(position.y)) == slot.bucket) {
+		buckets[slot.bucket].xs[slot.index] = position.x;
+		buckets[slot.bucket].ys[slot.index] = position.y;
+		return;
+	}
+	remove(id);
+	insert(id, position);
+}
+
+void SpatialHash::remove(uint32_t id) {
+	assert(id < slots.size() && slots[id].bucket != Absent);
+	Slot slot = slots[id];
+	Bucket &list = buckets[slot.bucket];
+	//swap-remove, fixing up the slot of whatever got moved into the hole:
+	list.ids[slot.index] = list.ids.back();
+	list.xs[slot.index] = list.xs.back();
+	list.ys[slot.index] = list.ys.back();
+	slots[list.ids[slot.index]].index = slot.index;
+	list.ids.pop_back();
+	list.xs.pop_back();
+	list.ys.pop_back();
+	slots[id].bucket = Absent;
+	--count;
+}
+
+void SpatialHash::clear() {
+	for (Bucket &list : buckets) {
+		list.ids.clear();
+		list.xs.clear();
+		list.ys.clear();
+	}
+	slots.clear();
+	count = 0;
+}
+
+void SpatialHash::grow() {
+	std::vector< Bucket > old(buckets.size() * 2);
+	old.swap(buckets);
+	for (Bucket const &list : old) {
+		for (uint32_t i = 0; i < list.size(); ++i) {
+			glm::vec2 position(list.xs[i], list.ys[i]);
+			uint32_t b = bucket(cell(position.x), cell(position.y));
+			slots[list.ids[i]] = Slot{b, buckets[b].size()};
+			buckets[b].push(list.ids[i], position);
+		}
+	}
+}
+
+void SpatialHash::in_radius(glm::vec2 const &center, float radius, std::vector< uint32_t > *out) const {
+	float r2 = radius * radius;
+	for_each_in_box(center - glm::vec2(radius), center + glm::vec2(radius), [&](uint32_t id, glm::vec2 const &p) {
+		glm::vec2 d = p - center;
+		if (d.x * d.x + d.y * d.y <= r2) out->emplace_back(id);
+	});
+}
+
+void SpatialHash::in_box(glm::vec2 const &min, glm::vec2 const &max, std::vector< uint32_t > *out) const {
+	for_each_in_box(min, max, [&](uint32_t id, glm::vec2 const &) {
+		out->emplace_back(id);
+	});
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "batch_aabb.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <stdint.h>
+
+/*
+ * Uniform-grid spatial hash over points, for "what is near here" queries.
+ *
+ * The plane is cut into square cells of side 'cell_size'; each cell hashes
+ * to a bucket holding the (id, position) of every point in it. Points are
+ * moved incrementally (a move within the same cell just rewrites the stored
+ * position), so a tick only pays for the things that actually moved, and a
+ * query only looks at buckets for cells its box overlaps.
+ *
+ * Ids are small dense integers (e.g. an index into Entities); the bucket
+ * table doubles whenever it holds more than two points per bucket.
+ * Buckets store their points as columns, so queries test a whole bucket
+ * against the box with the batched kernels in batch_aabb.hpp.
+ */
+
+struct SpatialHash {
+	explicit SpatialHash(float cell_size);
+
+	void insert(uint32_t id, glm::vec2 const &position);
+	void move(uint32_t id, glm::vec2 const &position);
+	void remove(uint32_t id);
+	void clear();
+
+	uint32_t size() const { return count; }
+
+	//call visit(id, position) for every point inside the closed box [min, max]:
+	template< typename F >
+	void for_each_in_box(glm::vec2 const &min, glm::vec2 const &max, F const &visit) const;
+
+	//ids of points within (Euclidean) 'radius' of 'center', appended to 'out':
+	void in_radius(glm::vec2 const &center, float radius, std::vector< uint32_t > *out) const;
+	//ids of points inside the closed box [min, max], appended to 'out':
+	void in_box(glm::vec2 const &min, glm::vec2 const &max, std::vector< uint32_t > *out) const;
+
+	struct Bucket {
+		std::vector< uint32_t > ids;
+		std::vector< float > xs, ys;
+		uint32_t size() const { return uint32_t(ids.size()); }
+		void push(uint32_t id, glm::vec2 const &position) {
+			ids.emplace_back(id);
+			xs.emplace_back(position.x);
+			ys.emplace_back(position.y);
+		}
+	};
+
+	float cell_size;
+	float inv_cell_size;
+	uint32_t count = 0;
+	std::vector< Bucket > buckets; //size is a power of two
+	AabbKernels const *kernels;
+	//where each id currently lives (bucket == Absent if it isn't in the hash):
+	struct Slot {
+		uint32_t bucket;
+		uint32_t index;
+	};
+	static constexpr uint32_t Absent = 0xffffffff;
+	std::vector< Slot > slots;
+
+	int32_t cell(float coord) const {
+		return int32_t(std::floor(coord * inv_cell_size));
+	}
+	uint32_t bucket(int32_t cx, int32_t cy) const {
+		uint32_t h = uint32_t(cx) * 73856093u ^ uint32_t(cy) * 19349663u;
+		return h & uint32_t(buckets.size() - 1);
+	}
+	void grow();
+	//index of lowest set bit of a nonzero mask byte:
+	static uint32_t ctz8(uint32_t bits) {
+		uint32_t n = 0;
+		while (!(bits & 1)) { bits >>= 1; ++n; }
+		return n;
+	}
+};
+
+template< typename F >
+void SpatialHash::for_each_in_box(glm::vec2 const &min, glm::vec2 const &max, F const &visit) const {
+	int32_t x0 = cell(min.x), x1 = cell(max.x);
+	int32_t y0 = cell(min.y), y1 = cell(max.y);
+	//box covers at least as many cells as there are buckets, so just look at every bucket once:
+	bool everything = (uint64_t(x1 - x0 + 1) * uint64_t(y1 - y0 + 1) >= buckets.size());
+
+	//test 'bucket' against the box a chunk at a time (masks live on the stack so queries can run concurrently):
+	auto scan = [&](Bucket const &bucket, int32_t cx, int32_t cy) {
+		constexpr uint32_t Chunk = 256;
+		uint8_t masks[Chunk / 8];
+		for (uint32_t begin = 0; begin < bucket.size(); begin += Chunk) {
+			uint32_t n = std::min(Chunk, bucket.size() - begin);
+			kernels->points_in_box(bucket.xs.data() + begin, bucket.ys.data() + begin, n, min, max, masks);
+			for (uint32_t m = 0; m < (n + 7) / 8; ++m) {
+				for (uint32_t bits = masks[m]; bits; bits &= bits - 1) {
+					uint32_t i = begin + 8 * m + ctz8(bits);
+					glm::vec2 p(bucket.xs[i], bucket.ys[i]);
+					//other cells can share this bucket; only report points that are really in (cx, cy)
+					// so that a bucket reached from two cells doesn't report its points twice:
+					if (!everything && (cell(p.x) != cx || cell(p.y) != cy)) continue;
+					visit(bucket.ids[i], p);
+				}
+			}
+		}
+	};
+
+	if (everything) {
+		for (Bucket const &bucket : buckets) {
+			scan(bucket, 0, 0);
+		}
+		return;
+	}
+	for (int32_t cy = y0; cy <= y1; ++cy) {
+		for (int32_t cx = x0; cx <= x1; ++cx) {
+			scan(buckets[bucket(cx, cy)], cx, cy);
+		}
+	}
+}
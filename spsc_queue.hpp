@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+/*
+ * Bounded single-producer / single-consumer queue, lock-free.
+ *
+ * One thread may push() and one (other) thread may front() / pop(); each
+ * side only writes its own index, and reads the other's with acquire
+ * ordering, so an item is fully written before the consumer can see it.
+ * Slots are allocated up front and items are moved in and out, so nothing
+ * allocates after construction (beyond what moving a T does).
+ */
+
+template< typename T >
+struct SpscQueue {
+	//room for at least 'capacity' items (rounded up to a power of two):
+	explicit SpscQueue(uint32_t capacity) {
+		uint32_t size = 1;
+		while (size < capacity) size *= 2;
+		slots.resize(size);
+	}
+	SpscQueue(SpscQueue const &) = delete;
+	SpscQueue &operator=(SpscQueue const &) = delete;
+
+	//(producer) add 'item' at the back; false (leaving 'item' alone) if the queue is full:
+	bool push(T &&item) {
+		uint32_t at = tail.load(std::memory_order_relaxed);
+		if (at - head.load(std::memory_order_acquire) == slots.size()) return false;
+		slots[at & (slots.size() - 1)] = std::move(item);
+		tail.store(at + 1, std::memory_order_release);
+		return true;
+	}
+
+	//(consumer) the oldest item, or null if the queue is empty; it stays in the queue until pop():
+	T *front() {
+		uint32_t at = head.load(std::memory_order_relaxed);
+		if (at == tail.load(std::memory_order_acquire)) return nullptr;
+		return &slots[at & (slots.size() - 1)];
+	}
+	//(consumer) drop the item front() returned:
+	void pop() {
+		head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	//(either side) whether the queue was empty just now:
+	bool empty() const {
+		return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+	}
+
+	//------------ internals ------------
+	std::vector< T > slots;
+	std::atomic< uint32_t > head{0}; //next item to pop (written by the consumer)
+	char padding[64]; //keep the two indices off each other's cache lines
+	std::atomic< uint32_t > tail{0}; //next slot to push into (written by the producer)
+};
@@ -0,0 +1,27 @@
+#include "startup_timeline.hpp"
+
+#include <iomanip>
+#include <iostream>
+
+StartupTimeline::StartupTimeline() : start(std::chrono::steady_clock::now()), last(start) {
+}
+
+void StartupTimeline::mark(char const *phase) {
+	auto now = std::chrono::steady_clock::now();
+	phases.emplace_back(Phase{phase, std::chrono::duration< float >(now - last).count()});
+	last = now;
+}
+
+float StartupTimeline::total() const {
+	return std::chrono::duration< float >(last - start).count();
+}
+
+void StartupTimeline::print_summary(std::ostream &out) const {
+	std::ios::fmtflags flags = out.flags();
+	out << std::fixed << std::setprecision(3);
+	for (auto const &phase : phases) {
+		out << "startup: " << std::left << std::setw(30) << phase.name << std::right << std::setw(10) << phase.seconds * 1000.0f << " ms\n";
+	}
+	out << "startup: " << std::left << std::setw(30) << "total (launch to first frame)" << std::right << std::setw(10) << total() * 1000.0f << " ms" << std::endl;
+	out.flags(flags);
+}
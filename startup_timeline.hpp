@@ -0,0 +1,33 @@
+#pragma once
+
+#include <chrono>
+#include <iosfwd>
+#include <vector>
+
+/*
+ * Records how long each startup phase takes, measured with a monotonic clock.
+ * Each call to mark() closes the phase that began at the previous mark()
+ * (or at construction, for the first phase).
+ */
+
+struct StartupTimeline {
+	StartupTimeline();
+
+	//end the current phase and label it 'phase' (name must be a string literal or otherwise outlive the timeline):
+	void mark(char const *phase);
+
+	//seconds from construction to the most recent mark():
+	float total() const;
+
+	//one "startup: <phase> <ms>" line per phase, plus the total:
+	void print_summary(std::ostream &out) const;
+
+	struct Phase {
+		char const *name;
+		float seconds;
+	};
+	std::vector< Phase > phases;
+
+	std::chrono::steady_clock::time_point start;
+	std::chrono::steady_clock::time_point last;
+};
@@ -0,0 +1,114 @@
+#include "streaming.hpp"
+#include "profiler.hpp"
+#include "memory_stats.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+ScreenStreamer::ScreenStreamer(GameState const &state, uint32_t capacity_) :
+	seed(state.seed), animals(state.animals), wizard_chunk(state.wizard_chunk), capacity(capacity_),
+	//(at most 'capacity' requests are outstanding, so the thread never waits to hand one back)
+	requests(capacity_), results(capacity_) {
+	requested.reserve(capacity);
+	ready.reserve(capacity);
+	thread = std::thread(&ScreenStreamer::thread_main, this);
+}
+
+ScreenStreamer::~ScreenStreamer() {
+	{
+		std::lock_guard< std::mutex > guard(sleep_lock);
+		quit = true;
+	}
+	wake.notify_one();
+	thread.join();
+}
+
+void ScreenStreamer::request(ChunkCoord const &chunk) {
+	if (std::find(requested.begin(), requested.end(), chunk) != requested.end()) return;
+	if (requested.size() == capacity) {
+		//the player has turned away from chunks we prepared; forget the oldest finished one to make room
+		// (if none are finished, try again next tick):
+		collect();
+		if (ready.empty()) return;
+		requested.erase(std::find(requested.begin(), requested.end(), ready.front().coord));
+		ready.erase(ready.begin());
+		counts.discarded += 1;
+	}
+	ChunkCoord item = chunk;
+	if (!requests.push(std::move(item))) return;
+	requested.emplace_back(chunk);
+	counts.requests += 1;
+	{
+		std::lock_guard< std::mutex > guard(sleep_lock);
+	}
+	wake.notify_one();
+}
+
+bool ScreenStreamer::take(ChunkCoord const &chunk, Screen *screen) {
+	auto pending = std::find(requested.begin(), requested.end(), chunk);
+	if (pending == requested.end()) {
+		counts.unrequested += 1;
+		return false;
+	}
+	requested.erase(pending);
+	PROFILE_ZONE("take chunk");
+	auto before = std::chrono::steady_clock::now();
+	bool waited = false;
+	while (true) {
+		collect();
+		for (auto at = ready.begin(); at != ready.end(); ++at) {
+			if (at->coord != chunk) continue;
+			*screen = std::move(*at);
+			ready.erase(at);
+			if (waited) {
+				counts.waits += 1;
+				counts.wait_seconds += std::chrono::duration< double >(std::chrono::steady_clock::now() - before).count();
+			} else {
+				counts.ready += 1;
+			}
+			return true;
+		}
+		//(still being generated; it's already underway, so this is quicker than starting over here)
+		waited = true;
+		std::this_thread::yield();
+	}
+}
+
+void ScreenStreamer::collect() {
+	while (Screen *prepared = results.front()) {
+		ready.emplace_back(std::move(*prepared));
+		results.pop();
+	}
+}
+
+void ScreenStreamer::thread_main() {
+	PROFILE_THREAD_NAME("streaming");
+	MemTagScope tag(MemTag::World); //(generate_screen tags entities itself)
+	while (true) {
+		ChunkCoord *chunk = requests.front();
+		if (!chunk) {
+			std::unique_lock< std::mutex > lock(sleep_lock);
+			wake.wait(lock, [this](){ return quit.load() || !requests.empty(); });
+			if (quit) return;
+			continue;
+		}
+		Screen prepared;
+		ChunkCoord at = *chunk;
+		requests.pop();
+		{
+			PROFILE_ZONE("generate chunk");
+			generate_screen(seed, at, animals, at == wizard_chunk, &prepared);
+		}
+		while (!results.push(std::move(prepared))) {
+			if (quit) return;
+			std::this_thread::yield();
+		}
+	}
+}
+
+void ScreenStreamer::report(std::ostream &out) const {
+	out << "Streaming: " << counts.requests << " chunks requested; " << counts.ready << " ready on arrival, "
+	    << counts.waits << " waited for (" << counts.wait_seconds * 1000.0 << " ms in all), "
+	    << counts.unrequested << " generated on arrival, " << counts.discarded << " discarded." << std::endl;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "game.hpp"
+#include "spsc_queue.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <iosfwd>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+/*
+ * Generates chunks of the world ahead of the player on a background thread.
+ *
+ * Each tick, the game asks for the chunk the player seems to be heading
+ * towards (predicted_chunk() in game.hpp) with request(). The streaming
+ * thread generates it and hands it back through a lock-free queue.
+ * When the player actually arrives, take() moves the prepared screen
+ * into the world, so the transition does no generation work. take() only
+ * waits if the screen was requested but isn't finished yet.
+ *
+ * Chunks are a pure function of the seed and their coordinates (see
+ * generate_screen), and are only installed when the player enters them.
+ * So the simulation is the same with or without streaming, however the
+ * threads are scheduled.
+ *
+ * request() and take() are called from the game thread only.
+ */
+
+struct ScreenStreamer {
+	//streams chunks of 'state''s world (reads its seed, animal count and wizard chunk now, never again);
+	// up to 'capacity' requests can be outstanding:
+	explicit ScreenStreamer(GameState const &state, uint32_t capacity = 4);
+	~ScreenStreamer();
+	ScreenStreamer(ScreenStreamer const &) = delete;
+	ScreenStreamer &operator=(ScreenStreamer const &) = delete;
+
+	//start generating 'chunk' (unless it has already been requested, or too many are outstanding):
+	void request(ChunkCoord const &chunk);
+	//move prepared 'chunk' into 'screen', waiting if it isn't finished; false if it was never requested:
+	bool take(ChunkCoord const &chunk, Screen *screen);
+
+	struct Stats {
+		uint64_t requests = 0;
+		uint64_t ready = 0; //taken without waiting
+		uint64_t waits = 0; //taken after waiting for the thread
+		double wait_seconds = 0.0;
+		uint64_t unrequested = 0; //take() calls for chunks that were never requested (generated by the game thread)
+		uint64_t discarded = 0; //prepared but dropped to make room, after the player turned away
+	};
+	Stats const &stats() const { return counts; }
+	void report(std::ostream &out) const;
+
+	//------------ internals ------------
+	uint32_t seed;
+	uint32_t animals;
+	ChunkCoord wizard_chunk;
+	uint32_t capacity;
+
+	SpscQueue< ChunkCoord > requests; //game thread -> streaming thread
+	SpscQueue< Screen > results; //streaming thread -> game thread
+	std::vector< ChunkCoord > requested; //requested, and not taken or discarded yet; at most 'capacity' (game thread only)
+	std::vector< Screen > ready; //results taken off the queue, waiting for the player (game thread only)
+	Stats counts;
+
+	std::atomic< bool > quit{false};
+	std::mutex sleep_lock;
+	std::condition_variable wake;
+	std::thread thread;
+
+	//move finished results from the queue into 'ready':
+	void collect();
+	void thread_main();
+};
@@ -0,0 +1,183 @@
+#include "texture_cache.hpp"
+#include "load_save_png.hpp"
+#include "memory_stats.hpp"
+#include "profiler.hpp"
+
+#include <iostream>
+
+TextureCache::TextureCache(JobSystem &jobs_, uint64_t budget, uint64_t upload_budget) : jobs(jobs_), budget_bytes(budget), upload_budget_bytes(upload_budget) {
+}
+
+TextureCache::~TextureCache() {
+	//(decode jobs write into their entries, so they have to finish first)
+	for (uint32_t id : decoding) {
+		jobs.wait(entries[id]->decoded);
+	}
+}
+
+uint32_t TextureCache::add(std::string const &filename) {
+	for (uint32_t id = 0; id < entries.size(); ++id) {
+		if (entries[id]->filename == filename) return id;
+	}
+	entries.emplace_back(new Entry);
+	entries.back()->filename = filename;
+	decoding.reserve(entries.size());
+	return uint32_t(entries.size() - 1);
+}
+
+void TextureCache::request(uint32_t id) {
+	Entry &entry = *entries[id];
+	entry.touched = frame;
+	if (entry.state == State::Unloaded) start_decode(id);
+	else if (entry.state == State::Resident) touch(id);
+}
+
+GLuint TextureCache::use(uint32_t id) {
+	counts.lookups += 1;
+	Entry &entry = *entries[id];
+	if (entry.state == State::Resident) {
+		counts.hits += 1;
+		entry.touched = frame;
+		touch(id);
+		return entry.name;
+	}
+	request(id);
+	return 0;
+}
+
+bool TextureCache::wait(uint32_t id) {
+	Entry &entry = *entries[id];
+	request(id);
+	if (entry.state == State::Decoding) {
+		jobs.wait(entry.decoded);
+		for (auto d = decoding.begin(); d != decoding.end(); ++d) {
+			if (*d == id) {
+				decoding.erase(d);
+				break;
+			}
+		}
+		upload(id);
+	}
+	return entry.state == State::Resident;
+}
+
+void TextureCache::start_decode(uint32_t id) {
+	Entry *entry = entries[id].get();
+	entry->state = State::Decoding;
+	decoding.emplace_back(id);
+	jobs.run([entry](){
+		PROFILE_ZONE("load_png");
+		MemTagScope tag(MemTag::Assets);
+		entry->loaded = load_png(entry->filename, &entry->width, &entry->height, &entry->pixels, LowerLeftOrigin);
+	}, &entry->decoded);
+}
+
+bool TextureCache::upload(uint32_t id) {
+	Entry &entry = *entries[id];
+	if (!entry.loaded) {
+		std::cerr << "Failed to load texture '" << entry.filename << "'." << std::endl;
+		entry.state = State::Failed;
+		return false;
+	}
+	glGenTextures(1, &entry.name);
+	glBindTexture(GL_TEXTURE_2D, entry.name);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, entry.width, entry.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, entry.pixels.data());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	entry.bytes = uint64_t(entry.width) * entry.height * 4;
+	gl_memory_upload(GLMemKind::Texture, entry.name, entry.bytes);
+	std::vector< uint32_t >().swap(entry.pixels);
+
+	entry.state = State::Resident;
+	link_newest(id);
+	counts.uploads += 1;
+	counts.uploaded_bytes += entry.bytes;
+	counts.resident_bytes += entry.bytes;
+	if (counts.resident_bytes > counts.peak_resident_bytes) counts.peak_resident_bytes = counts.resident_bytes;
+	return true;
+}
+
+void TextureCache::update() {
+	PROFILE_ZONE("texture cache");
+	//upload what has finished decoding, in request order, up to the per-frame upload budget:
+	uint64_t uploaded = 0;
+	uint32_t kept = 0;
+	for (uint32_t d = 0; d < decoding.size(); ++d) {
+		uint32_t id = decoding[d];
+		Entry &entry = *entries[id];
+		if (uploaded >= upload_budget_bytes || entry.decoded.pending.load() != 0) {
+			decoding[kept++] = id;
+			continue;
+		}
+		if (entry.touched + 1 < frame) {
+			//(not asked for since the frame before last, e.g. the player turned back; don't spend an upload on it)
+			std::vector< uint32_t >().swap(entry.pixels);
+			entry.state = State::Unloaded;
+			continue;
+		}
+		if (upload(id)) uploaded += entry.bytes;
+	}
+	decoding.resize(kept);
+	if (jobs.worker_count() == 1 && !decoding.empty()) {
+		//(no other threads to decode on; this thread only runs jobs inside wait(), so decode one per frame here)
+		jobs.wait(entries[decoding[0]]->decoded);
+	}
+
+	//evict the least recently touched textures until resident ones fit the budget:
+	while (counts.resident_bytes > budget_bytes && oldest != None && entries[oldest]->touched < frame) {
+		evict(oldest);
+		counts.evictions += 1;
+	}
+
+	frame += 1;
+}
+
+void TextureCache::release() {
+	while (oldest != None) {
+		evict(oldest);
+	}
+}
+
+void TextureCache::evict(uint32_t id) {
+	Entry &entry = *entries[id];
+	unlink(id);
+	glDeleteTextures(1, &entry.name);
+	gl_memory_delete(GLMemKind::Texture, entry.name);
+	entry.name = 0;
+	entry.state = State::Unloaded;
+	counts.resident_bytes -= entry.bytes;
+}
+
+void TextureCache::touch(uint32_t id) {
+	if (newest == id) return;
+	unlink(id);
+	link_newest(id);
+}
+
+void TextureCache::unlink(uint32_t id) {
+	Entry &entry = *entries[id];
+	if (entry.newer != None) entries[entry.newer]->older = entry.older;
+	else newest = entry.older;
+	if (entry.older != None) entries[entry.older]->newer = entry.newer;
+	else oldest = entry.newer;
+	entry.newer = entry.older = None;
+}
+
+void TextureCache::link_newest(uint32_t id) {
+	Entry &entry = *entries[id];
+	entry.newer = None;
+	entry.older = newest;
+	if (newest != None) entries[newest]->newer = id;
+	else oldest = id;
+	newest = id;
+}
+
+void TextureCache::report(std::ostream &out, double seconds) const {
+	out << "Textures: " << counts.hits << " of " << counts.lookups << " lookups hit";
+	if (counts.lookups) out << " (" << 100.0 * double(counts.hits) / double(counts.lookups) << "%)";
+	out << "; " << counts.uploads << " uploads, " << counts.uploaded_bytes << " bytes";
+	if (seconds > 0.0) out << " (" << double(counts.uploaded_bytes) / 1024.0 / seconds << " KB/s)";
+	out << "; " << counts.evictions << " evictions; " << counts.resident_bytes << " bytes resident (peak " << counts.peak_resident_bytes << ", budget " << budget_bytes << ")." << std::endl;
+}
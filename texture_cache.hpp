@@ -0,0 +1,103 @@
+#pragma once
+
+#include "GL.hpp"
+#include "jobs.hpp"
+
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/*
+ * Keeps sprite textures resident on the GPU within a memory budget.
+ *
+ * Textures are registered by file name with add(), and only loaded when
+ * something asks for them: request() (prefetching, e.g. for the screen the
+ * player is walking towards) or use() (drawing this frame). Loading decodes
+ * the file on the job system; update() (once per frame, on the GL thread)
+ * uploads finished decodes, then evicts the least recently requested or
+ * used textures until what is resident fits the budget. Textures touched
+ * during the current frame are never evicted, so a budget smaller than
+ * what one frame draws is exceeded rather than thrashed.
+ *
+ * Decoded pixels are dropped once uploaded; an evicted texture is decoded
+ * again from its file if it is needed later.
+ */
+
+struct TextureCache {
+	//'budget' bytes of texture memory; uploads stop for the frame once 'upload_budget' bytes have gone up (at least one always does):
+	TextureCache(JobSystem &jobs, uint64_t budget, uint64_t upload_budget = 4 * 1024 * 1024);
+	~TextureCache();
+	TextureCache(TextureCache const &) = delete;
+	TextureCache &operator=(TextureCache const &) = delete;
+
+	static constexpr uint32_t None = ~0u;
+
+	//id for the texture in 'filename' (the same id if it was added before); nothing is loaded yet:
+	uint32_t add(std::string const &filename);
+
+	//texture will be wanted soon; start loading it if it isn't resident, and mark it recently used:
+	void request(uint32_t id);
+	//GL name of the texture to draw with this frame, or 0 if it isn't resident yet (it is requested, and counted as a miss):
+	GLuint use(uint32_t id);
+	//load the texture now, blocking until it is resident (for startup); false if the file couldn't be loaded:
+	bool wait(uint32_t id);
+
+	//upload finished decodes and evict down to the budget; call once at the end of each frame:
+	void update();
+	//delete every GL texture (call before the GL context goes away):
+	void release();
+
+	struct Stats {
+		uint64_t lookups = 0; //use() calls
+		uint64_t hits = 0; //... that found the texture resident
+		uint64_t uploads = 0;
+		uint64_t uploaded_bytes = 0;
+		uint64_t evictions = 0;
+		uint64_t resident_bytes = 0;
+		uint64_t peak_resident_bytes = 0;
+	};
+	Stats const &stats() const { return counts; }
+	uint64_t budget() const { return budget_bytes; }
+	//hit rate, upload bandwidth over 'seconds', evictions and resident bytes against the budget:
+	void report(std::ostream &out, double seconds) const;
+
+	//------------ internals ------------
+	enum class State : uint8_t {
+		Unloaded, //(or evicted)
+		Decoding, //on the job system; 'decoded' drops to zero when done
+		Resident,
+		Failed, //couldn't be loaded; not retried
+	};
+	struct Entry {
+		std::string filename;
+		State state = State::Unloaded;
+		JobSystem::Counter decoded;
+		bool loaded = false; //(written by the decode job)
+		uint32_t width = 0, height = 0;
+		std::vector< uint32_t > pixels; //decoded, until uploaded
+		GLuint name = 0;
+		uint64_t bytes = 0;
+		uint64_t touched = 0; //frame last requested or used
+		//resident entries form a list, most recently touched first:
+		uint32_t newer = None, older = None;
+	};
+	std::vector< std::unique_ptr< Entry > > entries;
+	uint32_t newest = None, oldest = None;
+	std::vector< uint32_t > decoding; //entries in State::Decoding, oldest request first
+
+	JobSystem &jobs;
+	uint64_t budget_bytes;
+	uint64_t upload_budget_bytes;
+	uint64_t frame = 1;
+	Stats counts;
+
+	void start_decode(uint32_t id);
+	//upload a finished decode; false if it failed:
+	bool upload(uint32_t id);
+	void evict(uint32_t id);
+	void touch(uint32_t id);
+	void unlink(uint32_t id);
+	void link_newest(uint32_t id);
+};
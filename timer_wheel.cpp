@@ -0,0 +1,63 @@
+#include "timer_wheel.hpp"
+
+#include <cassert>
+
+TimerWheel::TimerWheel(uint64_t now) : current(now) {
+}
+
+void TimerWheel::schedule(uint64_t due, uint64_t payload) {
+	uint32_t node;
+	if (free_nodes != None) {
+		node = free_nodes;
+		free_nodes = nodes[node].next;
+	} else {
+		node = uint32_t(nodes.size());
+		nodes.emplace_back();
+	}
+	nodes[node].due = (due > current ? due : current + 1);
+	nodes[node].payload = payload;
+	place(node);
+	++count;
+}
+
+void TimerWheel::append(List &list, uint32_t node) {
+	nodes[node].next = None;
+	if (list.tail == None) list.head = node;
+	else nodes[list.tail].next = node;
+	list.tail = node;
+}
+
+void TimerWheel::place(uint32_t node) {
+	uint64_t due = nodes[node].due;
+	assert(due >= current); //(equal when cascading onto the tick being fired)
+	//the level is the highest byte in which 'due' differs from 'current'; that slot comes up before 'due' does:
+	uint64_t differ = due ^ current;
+	for (uint32_t level = 0; level < Levels; ++level) {
+		if ((differ >> (SlotBits * (level + 1))) == 0) {
+			append(slots[level][(due >> (SlotBits * level)) & (Slots - 1)], node);
+			return;
+		}
+	}
+	append(far, node);
+}
+
+void TimerWheel::cascade() {
+	//(highest level first, so its timers land in the lower slots that are cascaded next)
+	uint32_t top = 1;
+	while (top < Levels && ((current >> (SlotBits * top)) & (Slots - 1)) == 0) ++top;
+	if (top == Levels) {
+		for (uint32_t node = detach(far); node != None; ) {
+			uint32_t next = nodes[node].next;
+			place(node);
+			node = next;
+		}
+	}
+	for (uint32_t level = (top < Levels ? top : Levels - 1); level >= 1; --level) {
+		//(everything here now lands in a lower level)
+		for (uint32_t node = detach(slots[level][(current >> (SlotBits * level)) & (Slots - 1)]); node != None; ) {
+			uint32_t next = nodes[node].next;
+			place(node);
+			node = next;
+		}
+	}
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <stdint.h>
+
+/*
+ * Hierarchical timer wheel, for things that happen at a known future tick
+ * (animal respawns) without polling everything that might be due.
+ *
+ * Time is counted in ticks. Level l has 256 slots, each covering 256^l
+ * ticks. A timer goes in the lowest level that can reach its due tick.
+ * When the level below wraps around, the next slot up is "cascaded": its
+ * timers are moved down a level. So a timer is touched at most once per
+ * level, and scheduling and firing are both O(1) however many timers are
+ * pending. Timers due more than 2^32 ticks ahead wait in a 'far' list until
+ * the top level wraps.
+ *
+ * Timers live in one node array, linked into per-slot lists, with freed
+ * nodes reused; once reserve() (or the first few seconds of play) has made
+ * room for the most timers ever pending at once, nothing allocates.
+ *
+ * Firing order depends only on the sequence of schedule() and advance()
+ * calls, so replays and checksums stay deterministic.
+ */
+
+struct TimerWheel {
+	explicit TimerWheel(uint64_t now = 0);
+
+	//make room for 'count' pending timers without allocating:
+	void reserve(size_t count) { nodes.reserve(count); }
+
+	//fire 'payload' on tick 'due' (or on the next tick, if 'due' has already passed):
+	void schedule(uint64_t due, uint64_t payload);
+
+	//step time forward to tick 'now', calling fire(payload) for every timer due by then, in due order
+	// (fire may schedule more timers):
+	template< typename F >
+	void advance(uint64_t now, F const &fire);
+
+	uint64_t now() const { return current; }
+	//timers waiting to fire:
+	size_t size() const { return count; }
+
+	//------------ internals ------------
+	static constexpr uint32_t Levels = 4;
+	static constexpr uint32_t SlotBits = 8;
+	static constexpr uint32_t Slots = 1 << SlotBits;
+	static constexpr uint32_t None = ~0u;
+
+	struct Node {
+		uint64_t due; //tick to fire on
+		uint64_t payload; //passed back to advance()'s callback
+		uint32_t next; //next node in the same list (or free list), or None
+	};
+	std::vector< Node > nodes;
+	uint32_t free_nodes = None;
+
+	//a FIFO list of nodes (so timers in one slot keep their order):
+	struct List {
+		uint32_t head = None;
+		uint32_t tail = None;
+	};
+	List slots[Levels][Slots];
+	List far; //due 2^32 or more ticks after 'current' when scheduled
+	uint64_t current;
+	size_t count = 0;
+
+	void append(List &list, uint32_t node);
+	//take all of a list's nodes (as a chain through Node::next):
+	static uint32_t detach(List &list) {
+		uint32_t head = list.head;
+		list.head = list.tail = None;
+		return head;
+	}
+	void place(uint32_t node);
+	//'current' just moved to a new tick; move down any timers whose higher-level slot came up:
+	void cascade();
+};
+
+template< typename F >
+void TimerWheel::advance(uint64_t now, F const &fire) {
+	while (current < now) {
+		++current;
+		if ((current & (Slots - 1)) == 0) cascade();
+		uint32_t node = detach(slots[0][current & (Slots - 1)]);
+		while (node != None) {
+			//(free the node before firing, so 'fire' can reuse it)
+			uint32_t next = nodes[node].next;
+			uint64_t payload = nodes[node].payload;
+			nodes[node].next = free_nodes;
+			free_nodes = node;
+			--count;
+			fire(payload);
+			node = next;
+		}
+	}
+}
@@ -0,0 +1,223 @@
+#include "world_save.hpp"
+#include "profiler.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+static uint32_t const WorldSaveVersion = 1;
+static char const ChunkRecord = 'C';
+static char const TimeRecord = 'T';
+
+//write 'delta' as a chunk record; returns its size in bytes:
+static uint64_t write_delta(std::ostream &out, ChunkDelta const &delta) {
+	out.put(ChunkRecord);
+	out.write(reinterpret_cast< char const * >(&delta.coord.x), 4);
+	out.write(reinterpret_cast< char const * >(&delta.coord.y), 4);
+	out.write(reinterpret_cast< char const * >(&delta.cut), 4);
+	uint64_t bytes = 13;
+	for (uint32_t i = 0; i < uint32_t(TreesPerScreen); ++i) {
+		if (!(delta.cut & (1u << i))) continue;
+		out.write(reinterpret_cast< char const * >(&delta.grown_at[i]), 4);
+		bytes += 4;
+	}
+	return bytes;
+}
+
+static void write_time(std::ostream &out, float time) {
+	out.put(TimeRecord);
+	out.write(reinterpret_cast< char const * >(&time), 4);
+}
+
+bool load_world_deltas(std::string const &filename, uint32_t *seed, ChunkDeltas *deltas, float now) {
+	std::ifstream file(filename.c_str(), std::ios::binary);
+	if (!file) return true; //(nothing saved yet)
+
+	char magic[4];
+	uint32_t version = 0;
+	uint32_t saved_seed = 0;
+	if (!file.read(magic, 4) || std::memcmp(magic, "FBWD", 4) != 0
+	 || !file.read(reinterpret_cast< char * >(&version), 4) || version != WorldSaveVersion
+	 || !file.read(reinterpret_cast< char * >(&saved_seed), 4)) {
+		std::cerr << "'" << filename << "' is not a (current version) world save." << std::endl;
+		return false;
+	}
+
+	ChunkDeltas saved;
+	float clock = 0.0f;
+	while (true) {
+		int tag = file.get();
+		if (tag == EOF) break;
+		bool complete = false;
+		if (tag == ChunkRecord) {
+			ChunkDelta delta;
+			complete = file.read(reinterpret_cast< char * >(&delta.coord.x), 4)
+			        && file.read(reinterpret_cast< char * >(&delta.coord.y), 4)
+			        && file.read(reinterpret_cast< char * >(&delta.cut), 4);
+			for (uint32_t i = 0; complete && i < uint32_t(TreesPerScreen); ++i) {
+				if (!(delta.cut & (1u << i))) continue;
+				complete = bool(file.read(reinterpret_cast< char * >(&delta.grown_at[i]), 4));
+			}
+			if (complete) saved[delta.coord.key()] = delta;
+		} else if (tag == TimeRecord) {
+			complete = bool(file.read(reinterpret_cast< char * >(&clock), 4));
+		} else {
+			std::cerr << "World save '" << filename << "' contains an unknown record." << std::endl;
+			return false;
+		}
+		if (!complete) {
+			//(the game stopped partway through appending; everything before is fine)
+			std::cerr << "NOTE: world save '" << filename << "' ends in a partial record; ignoring it." << std::endl;
+			break;
+		}
+	}
+
+	//move times over to the new clock, and forget trees that had grown back before the save was closed:
+	deltas->clear();
+	for (auto &entry : saved) {
+		ChunkDelta delta = entry.second;
+		for (uint32_t i = 0; i < uint32_t(TreesPerScreen); ++i) {
+			if (!(delta.cut & (1u << i))) continue;
+			if (delta.grown_at[i] <= clock) delta.cut &= ~(1u << i);
+			else delta.grown_at[i] = delta.grown_at[i] - clock + now;
+		}
+		if (delta.cut) deltas->emplace(entry.first, delta);
+	}
+	*seed = saved_seed;
+	return true;
+}
+
+WorldSaver::WorldSaver(std::string const &filename_, GameState const &state, uint32_t capacity) : filename(filename_), queue(capacity) {
+	waiting.reserve(capacity);
+	start(state);
+}
+
+void WorldSaver::start(GameState const &state) {
+	auto before = std::chrono::steady_clock::now();
+	last_time = state.totalTime;
+
+	//start from a compact copy of what's known so far (written alongside, then moved over the old file,
+	// so there's always a whole save on disk):
+	std::string temporary = filename + ".tmp";
+	{
+		std::ofstream out(temporary.c_str(), std::ios::binary);
+		if (!out) throw std::runtime_error("Failed to open '" + temporary + "' for saving the world.");
+		out.write("FBWD", 4);
+		out.write(reinterpret_cast< char const * >(&WorldSaveVersion), 4);
+		out.write(reinterpret_cast< char const * >(&state.seed), 4);
+		counts.bytes = 12;
+		for (auto const &entry : state.deltas) {
+			counts.bytes += write_delta(out, entry.second);
+			counts.records += 1;
+		}
+		write_time(out, state.totalTime);
+		counts.bytes += 5;
+		out.close();
+		if (!out) throw std::runtime_error("Failed to write '" + temporary + "'.");
+	}
+	if (std::rename(temporary.c_str(), filename.c_str()) != 0) {
+		//(Windows won't rename over an existing file)
+		std::remove(filename.c_str());
+		if (std::rename(temporary.c_str(), filename.c_str()) != 0) {
+			throw std::runtime_error("Failed to replace '" + filename + "' with '" + temporary + "'.");
+		}
+	}
+	file.open(filename.c_str(), std::ios::binary | std::ios::app);
+	if (!file) throw std::runtime_error("Failed to open '" + filename + "' for saving the world.");
+	counts.seconds += std::chrono::duration< double >(std::chrono::steady_clock::now() - before).count();
+
+	thread = std::thread(&WorldSaver::thread_main, this);
+}
+
+WorldSaver::~WorldSaver() {
+	if (!finished) finish(last_time);
+}
+
+void WorldSaver::changed(ChunkDelta const &delta, float now) {
+	last_time = now;
+	//(anything still waiting goes first, so records stay in order)
+	uint32_t sent = 0;
+	while (sent < waiting.size()) {
+		ChunkDelta item = waiting[sent];
+		if (!queue.push(std::move(item))) break;
+		sent += 1;
+	}
+	waiting.erase(waiting.begin(), waiting.begin() + sent);
+	ChunkDelta item = delta;
+	if (!waiting.empty() || !queue.push(std::move(item))) {
+		waiting.emplace_back(delta);
+		counts.backlog += 1;
+	}
+	{
+		std::lock_guard< std::mutex > guard(sleep_lock);
+	}
+	wake.notify_one();
+}
+
+void WorldSaver::stop() {
+	{
+		std::lock_guard< std::mutex > guard(sleep_lock);
+		quit = true;
+	}
+	wake.notify_one();
+	thread.join(); //(after writing everything queued)
+	quit = false;
+}
+
+void WorldSaver::rewrite(GameState const &state) {
+	if (finished) return;
+	stop();
+	waiting.clear(); //(superseded, like everything already in the file)
+	file.close();
+	start(state);
+}
+
+void WorldSaver::finish(float now) {
+	if (finished) return;
+	finished = true;
+	stop();
+
+	auto before = std::chrono::steady_clock::now();
+	for (ChunkDelta const &delta : waiting) {
+		write_record(delta);
+	}
+	waiting.clear();
+	write_time(file, now);
+	counts.bytes += 5;
+	file.close();
+	counts.seconds += std::chrono::duration< double >(std::chrono::steady_clock::now() - before).count();
+	if (!file) {
+		std::cerr << "Failed to write world save '" << filename << "'." << std::endl;
+	}
+}
+
+void WorldSaver::write_record(ChunkDelta const &delta) {
+	counts.bytes += write_delta(file, delta);
+	counts.records += 1;
+}
+
+void WorldSaver::thread_main() {
+	PROFILE_THREAD_NAME("saving");
+	while (true) {
+		if (queue.empty()) {
+			std::unique_lock< std::mutex > lock(sleep_lock);
+			wake.wait(lock, [this](){ return quit.load() || !queue.empty(); });
+			if (queue.empty()) return; //(quitting, with everything written)
+		}
+		PROFILE_ZONE("save changes");
+		auto before = std::chrono::steady_clock::now();
+		while (ChunkDelta *delta = queue.front()) {
+			write_record(*delta);
+			queue.pop();
+		}
+		file.flush();
+		counts.seconds += std::chrono::duration< double >(std::chrono::steady_clock::now() - before).count();
+	}
+}
+
+void WorldSaver::report(std::ostream &out) const {
+	out << "World save: " << counts.records << " chunk records, " << counts.bytes << " bytes, "
+	    << counts.seconds * 1000.0 << " ms writing (" << counts.backlog << " changes waited for room in the queue)." << std::endl;
+}
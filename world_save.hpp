@@ -0,0 +1,94 @@
+#pragma once
+
+#include "game.hpp"
+#include "spsc_queue.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+/*
+ * Saving the changes the player makes to the world.
+ *
+ * Chunks are regenerated from the seed whenever they're loaded (see
+ * generate_screen), so a save only needs the seed and each changed chunk's
+ * delta (GameState::deltas: which trees are cut, and when they grow back).
+ * The save's size and the time it takes grow with the number of changes,
+ * not with how much of the world has been seen.
+ *
+ * The file is a log. A WorldSaver rewrites it once from the deltas it
+ * starts with, which also drops superseded records. After that it appends a
+ * record for each change on a background thread, so the game thread never
+ * waits on the disk. If the game's deltas are replaced wholesale (loading
+ * a snapshot), rewrite() starts the file over from the new ones. Loading
+ * reads the records into a ChunkDeltas. Each delta is applied when its
+ * chunk is next generated or streamed in.
+ *
+ * Format (native byte order and float layout, as written by the machine that
+ * made it; a save isn't meant to move between machines of different endianness):
+ *   "FBWD" | u32 version | u32 seed
+ *   then records, each starting with a u8 tag:
+ *     'C' | i32 x | i32 y | u32 cut | f32 grown_at for each bit set in cut
+ *         (a chunk's delta; replaces any earlier record for the same chunk)
+ *     'T' | f32 time
+ *         (the world clock when the file was closed; grown_at values before it
+ *          are relative to it)
+ */
+
+//read the deltas saved in 'filename' into 'deltas', with their times moved so the saved clock lines up with 'now';
+// a missing file is an unchanged world (and leaves 'seed' alone), otherwise 'seed' is set to the world's seed.
+// Returns false (with a message on std::cerr) if the file is malformed:
+bool load_world_deltas(std::string const &filename, uint32_t *seed, ChunkDeltas *deltas, float now = 0.0f);
+
+struct WorldSaver {
+	//write 'state''s seed and deltas to 'filename', then append changes as they're reported;
+	// throws std::runtime_error if 'filename' can't be written:
+	WorldSaver(std::string const &filename, GameState const &state, uint32_t capacity = 64);
+	~WorldSaver(); //calls finish() if needed
+	WorldSaver(WorldSaver const &) = delete;
+	WorldSaver &operator=(WorldSaver const &) = delete;
+
+	//(game thread) 'delta' changed at world time 'now'; queue it to be appended:
+	void changed(ChunkDelta const &delta, float now);
+	//(game thread) append everything queued and the clock 'now', and close the file:
+	void finish(float now);
+	//(game thread) 'state''s deltas were replaced wholesale (e.g. by loading a snapshot), so start the file over
+	// from them, dropping anything still queued; throws std::runtime_error if 'filename' can't be written:
+	void rewrite(GameState const &state);
+
+	struct Stats {
+		uint64_t records = 0; //chunk records written (including the rewrite at the start)
+		uint64_t bytes = 0; //file size
+		double seconds = 0.0; //spent writing (all on the saving thread, apart from the rewrite at the start and the last records in finish())
+		uint64_t backlog = 0; //changes that found the queue full, and waited on the game thread
+	};
+	//(read it after finish())
+	Stats const &stats() const { return counts; }
+	void report(std::ostream &out) const;
+
+	//------------ internals ------------
+	std::string filename;
+	std::ofstream file;
+	float last_time = 0.0f; //latest 'now' passed to changed()
+	bool finished = false;
+
+	SpscQueue< ChunkDelta > queue; //game thread -> saving thread
+	std::vector< ChunkDelta > waiting; //(game thread) changes that didn't fit in the queue yet
+	Stats counts;
+
+	std::atomic< bool > quit{false};
+	std::mutex sleep_lock;
+	std::condition_variable wake;
+	std::thread thread;
+
+	void start(GameState const &state); //write the compact copy and start the saving thread
+	void stop(); //stop the saving thread, after it has written everything queued
+	void write_record(ChunkDelta const &delta);
+	void thread_main();
+};